@@ -0,0 +1,222 @@
+#ifndef FIXEDMATRIX_HPP
+#define FIXEDMATRIX_HPP
+
+#include "Matrix.hpp"
+#include "expm_batch.hpp"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// N x M matrix with the size known at compile time. Storage is a plain
+// row-major array on the stack, so small matrices (Jacobians, 2x2 to 4x4
+// blocks) need no heap allocation and all loops have constant bounds.
+
+template <int N, int M>
+class FixedMatrix;
+
+// std::fabs is not constexpr before C++23
+constexpr double fixed_abs(const double x) { return x < 0 ? -x : x; }
+
+// Determinant, closed form for small sizes like r8mat_det_2d/3d,
+// LU with partial pivoting otherwise.
+template <int N>
+struct FixedDet {
+	static constexpr double det(const FixedMatrix<N, N>& m) {
+		FixedMatrix<N, N> lu = m;
+		double res = 1.0;
+		for (int p = 0; p < N; p++){
+			int piv = p;
+			for (int i = p + 1; i < N; i++)
+				if (fixed_abs(lu[i][p]) > fixed_abs(lu[piv][p])) piv = i;
+			if (lu[piv][p] == 0.0) return 0.0;
+			if (piv != p){
+				for (int j = 0; j < N; j++){
+					double t = lu[p][j]; lu[p][j] = lu[piv][j]; lu[piv][j] = t;
+				}
+				res = -res;
+			}
+			res *= lu[p][p];
+			for (int i = p + 1; i < N; i++){
+				const double f = lu[i][p] / lu[p][p];
+				for (int j = p + 1; j < N; j++)
+					lu[i][j] -= f * lu[p][j];
+			}
+		}
+		return res;
+	}
+};
+
+template <>
+struct FixedDet<1> {
+	static constexpr double det(const FixedMatrix<1, 1>& m);
+};
+
+template <>
+struct FixedDet<2> {
+	static constexpr double det(const FixedMatrix<2, 2>& m);
+};
+
+template <>
+struct FixedDet<3> {
+	static constexpr double det(const FixedMatrix<3, 3>& m);
+};
+
+template <int N, int M>
+class FixedMatrix {
+public:
+	static constexpr FixedMatrix eye() {
+		static_assert(N == M, "Identity matrix must be square");
+		FixedMatrix m;
+		for (int i = 0; i < N; i++)
+			m[i][i] = 1.0;
+		return m;
+	}
+
+	constexpr FixedMatrix() : array{} {}
+
+	explicit FixedMatrix(const Matrix& matrix) : array{} {
+		if (matrix.getRows() != (unsigned)N || matrix.getCols() != (unsigned)M)
+			throw std::invalid_argument("Size of matrices does not align");
+		memcpy(array, matrix.getArray(), sizeof(double)*N*M);
+	}
+
+	Matrix toMatrix() const {
+		Matrix m(N, M);
+		memcpy(m.getArray(), array, sizeof(double)*N*M);
+		return m;
+	}
+
+	constexpr double* operator[](int i) { return &array[i*M]; }
+	constexpr const double* operator[](int i) const { return &array[i*M]; }
+
+	constexpr FixedMatrix& operator+=(const FixedMatrix& m) {
+		for (int k = 0; k < N*M; k++) array[k] += m.array[k];
+		return *this;
+	}
+	constexpr FixedMatrix& operator-=(const FixedMatrix& m) {
+		for (int k = 0; k < N*M; k++) array[k] -= m.array[k];
+		return *this;
+	}
+	constexpr FixedMatrix& operator*=(const double value) {
+		for (int k = 0; k < N*M; k++) array[k] *= value;
+		return *this;
+	}
+	constexpr FixedMatrix operator+(const FixedMatrix& m) const { FixedMatrix r = *this; r += m; return r; }
+	constexpr FixedMatrix operator-(const FixedMatrix& m) const { FixedMatrix r = *this; r -= m; return r; }
+	constexpr FixedMatrix operator*(const double value) const { FixedMatrix r = *this; r *= value; return r; }
+
+	template <int K>
+	constexpr FixedMatrix<N, K> operator*(const FixedMatrix<M, K>& m) const {
+		FixedMatrix<N, K> res;
+		for (int i = 0; i < N; i++)
+			for (int k = 0; k < M; k++)
+				for (int j = 0; j < K; j++)
+					res[i][j] += (*this)[i][k] * m[k][j];
+		return res;
+	}
+
+	constexpr FixedMatrix<M, N> transpose() const {
+		FixedMatrix<M, N> res;
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < M; j++)
+				res[j][i] = (*this)[i][j];
+		return res;
+	}
+
+	constexpr double det() const {
+		static_assert(N == M, "Determinant only defined for square matrices");
+		return FixedDet<N>::det(*this);
+	}
+
+	constexpr FixedMatrix inverse() const;
+
+	// Same Pade approximant as r8mat_expm1, through the batch kernel.
+	FixedMatrix exp() const {
+		static_assert(N == M, "Matrix exponential only defined for square matrices");
+		FixedMatrix res;
+		expm_pade_lanes<N, 1>(array, res.array);
+		return res;
+	}
+
+	double norm() const {
+		double res = 0;
+		for (int k = 0; k < N*M; k++) res += array[k]*array[k];
+		return std::sqrt(res);
+	}
+
+	double array[N*M];
+};
+
+constexpr double FixedDet<1>::det(const FixedMatrix<1, 1>& m) {
+	return m[0][0];
+}
+
+constexpr double FixedDet<2>::det(const FixedMatrix<2, 2>& m) {
+	return m[0][0]*m[1][1] - m[0][1]*m[1][0];
+}
+
+constexpr double FixedDet<3>::det(const FixedMatrix<3, 3>& m) {
+	return m[0][0] * (m[1][1]*m[2][2] - m[1][2]*m[2][1])
+		 + m[0][1] * (m[1][2]*m[2][0] - m[1][0]*m[2][2])
+		 + m[0][2] * (m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+}
+
+// Gauss-Jordan with partial pivoting
+template <int N>
+struct FixedInverse {
+	static constexpr FixedMatrix<N, N> inverse(const FixedMatrix<N, N>& m) {
+		FixedMatrix<N, N> a = m;
+		FixedMatrix<N, N> res = FixedMatrix<N, N>::eye();
+		for (int p = 0; p < N; p++){
+			int piv = p;
+			for (int i = p + 1; i < N; i++)
+				if (fixed_abs(a[i][p]) > fixed_abs(a[piv][p])) piv = i;
+			if (a[piv][p] == 0.0)
+				throw std::invalid_argument("Matrix is singular");
+			if (piv != p){
+				for (int j = 0; j < N; j++){
+					double t = a[p][j]; a[p][j] = a[piv][j]; a[piv][j] = t;
+					t = res[p][j]; res[p][j] = res[piv][j]; res[piv][j] = t;
+				}
+			}
+			const double inv = 1.0 / a[p][p];
+			for (int j = 0; j < N; j++){
+				a[p][j] *= inv;
+				res[p][j] *= inv;
+			}
+			for (int i = 0; i < N; i++){
+				if (i == p) continue;
+				const double f = a[i][p];
+				for (int j = 0; j < N; j++){
+					a[i][j] -= f * a[p][j];
+					res[i][j] -= f * res[p][j];
+				}
+			}
+		}
+		return res;
+	}
+};
+
+// Closed form, as r8mat_inverse_2d
+template <>
+struct FixedInverse<2> {
+	static constexpr FixedMatrix<2, 2> inverse(const FixedMatrix<2, 2>& m) {
+		const double d = m.det();
+		if (d == 0.0)
+			throw std::invalid_argument("Matrix is singular");
+		FixedMatrix<2, 2> res;
+		res[0][0] =  m[1][1] / d;
+		res[0][1] = -m[0][1] / d;
+		res[1][0] = -m[1][0] / d;
+		res[1][1] =  m[0][0] / d;
+		return res;
+	}
+};
+
+template <int N, int M>
+constexpr FixedMatrix<N, M> FixedMatrix<N, M>::inverse() const {
+	static_assert(N == M, "Inverse only defined for square matrices");
+	return FixedInverse<N>::inverse(*this);
+}
+
+#endif
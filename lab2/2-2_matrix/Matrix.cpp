@@ -5,11 +5,14 @@
 #include <cstring>
 #include <cmath>
 #include <stdexcept>
+#include <algorithm>
+#include <utility>
 
 // Identity matrix
-Matrix Matrix::eye(const unsigned int n)
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::eye(const unsigned int n)
 {
-	Matrix m(n);
+	BasicMatrix m(n);
 	#pragma omp parallel for
 	for(unsigned int i=0; i<n; i++){
 		for (unsigned int j=0; j<n; j++){
@@ -20,17 +23,19 @@ Matrix Matrix::eye(const unsigned int n)
 	return m;
 }
 
-Matrix Matrix::random(const unsigned int i)
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::random(const unsigned int i)
 {
-	return Matrix::random(i, i);
+	return BasicMatrix::random(i, i);
 }
 
-Matrix Matrix::random(const unsigned int rows, const unsigned int cols)
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::random(const unsigned int rows, const unsigned int cols)
 {
 
-	Matrix m(rows, cols);
+	BasicMatrix m(rows, cols);
 	for(unsigned int i=0; i<rows*cols; i++){
-		m.array[i] = (double)rand()/(double) RAND_MAX;
+		m.array[i] = (T)((double)rand()/(double) RAND_MAX);
 	}
 
 	return m;
@@ -39,29 +44,47 @@ Matrix Matrix::random(const unsigned int rows, const unsigned int cols)
 // =============================================================== //
 // Constructors
 
-Matrix::Matrix(int m): Matrix(m,m) {}
+template <class T>
+BasicMatrix<T>::BasicMatrix(int m): BasicMatrix(m,m) {}
 
-Matrix::Matrix(int m, int n)
+template <class T>
+BasicMatrix<T>::BasicMatrix(int m, int n)
 : rows(m), cols(n)
 {
-	this->array = new double[this->rows*this->cols];
+	this->array = new T[this->rows*this->cols];
 }
 
-Matrix::Matrix(const Matrix& matrix)
-: Matrix(matrix.rows, matrix.cols)
+template <class T>
+BasicMatrix<T>::BasicMatrix(const BasicMatrix& matrix)
+: BasicMatrix(matrix.rows, matrix.cols)
 {
-	memcpy(this->array, matrix.array, sizeof(double)*this->rows*this->cols);
+	memcpy(this->array, matrix.array, sizeof(T)*this->rows*this->cols);
+}
+
+template <class T>
+template <class U>
+BasicMatrix<T>::BasicMatrix(const BasicMatrix<U>& matrix)
+: BasicMatrix(matrix.getRows(), matrix.getCols())
+{
+	const U* src = matrix.getArray();
+	const unsigned long n = (unsigned long)this->rows*this->cols;
+	#pragma omp parallel for simd
+	for (unsigned long i=0; i<n; i++){
+		this->array[i] = (T)src[i];
+	}
 }
 // =============================================================== //
 // Destructor
-Matrix::~Matrix()
+template <class T>
+BasicMatrix<T>::~BasicMatrix()
 {
 	delete[] this->array;
 }
 
 // =============================================================== //
 // Arithmetic operators
-Matrix& Matrix::operator=(const Matrix& matrix)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator=(const BasicMatrix& matrix)
 {
 
 	if(this->rows != matrix.rows || this->cols != matrix.cols){
@@ -69,14 +92,15 @@ Matrix& Matrix::operator=(const Matrix& matrix)
 		this->cols = matrix.cols;
 
 		delete[] this->array;
-		this->array = new double[this->rows*this->cols];		
+		this->array = new T[this->rows*this->cols];		
 	}
 
-	memcpy(this->array, matrix.array, sizeof(double)*this->rows*this->cols);
+	memcpy(this->array, matrix.array, sizeof(T)*this->rows*this->cols);
 	return *this;
 }
 
-Matrix& Matrix::operator+=(const Matrix& matrix)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator+=(const BasicMatrix& matrix)
 {
 	if(this->rows != matrix.rows || this->cols != matrix.cols){
 		throw std::invalid_argument("Size of matrices does not align");
@@ -88,7 +112,8 @@ Matrix& Matrix::operator+=(const Matrix& matrix)
 	return *this;
 }
 
-Matrix& Matrix::operator+=(const double value)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator+=(const T value)
 {
 
 	for(unsigned int i=0; i<this->rows*this->cols; i++){
@@ -97,7 +122,8 @@ Matrix& Matrix::operator+=(const double value)
 	return *this;
 }
 
-Matrix& Matrix::operator-=(const Matrix& matrix)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator-=(const BasicMatrix& matrix)
 {
 	if(this->rows != matrix.rows || this->cols != matrix.cols){
 		throw std::invalid_argument("Size of matrices does not align");
@@ -109,29 +135,14 @@ Matrix& Matrix::operator-=(const Matrix& matrix)
 	return *this;
 }
 
-Matrix operator+(const Matrix& m1, const Matrix& m2)
-{
-	Matrix m(m1);
-
-	m += m2;
-	return m;
-}
-
-Matrix operator-(const Matrix& m1, const Matrix& m2)
-{
-	Matrix m(m1);
-
-	m -= m2;
-	return m;
-}
-
-Matrix& Matrix::operator*=(const Matrix& matrix)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator*=(const BasicMatrix& matrix)
 {
 	if(this->cols != matrix.rows)
 		throw std::invalid_argument("Second dimension of first matrix does not match first dimension of second matrix.");
 
-	double *arr = new double[matrix.cols*this->rows];
-	memset(arr, 0, sizeof(double)*matrix.cols*this->rows);
+	T *arr = new T[matrix.cols*this->rows];
+	memset(arr, 0, sizeof(T)*matrix.cols*this->rows);
 
 	#pragma omp parallel for
 	for( unsigned int i=0; i<this->rows; i++){
@@ -150,15 +161,8 @@ Matrix& Matrix::operator*=(const Matrix& matrix)
 	return *this;
 }
 
-Matrix operator*(const Matrix& m1, const Matrix& m2)
-{
-	Matrix m(m1);
-
-	m *= m2;
-	return m;
-}
-
-Matrix& Matrix::operator*=(const double value)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator*=(const T value)
 {
 
 	for( unsigned int i=0; i<this->rows*this->cols; i++){
@@ -167,7 +171,8 @@ Matrix& Matrix::operator*=(const double value)
 	return *this;
 }
 
-Matrix& Matrix::operator/=(const double value)
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::operator/=(const T value)
 {
 	*this *= (1/value);
 	return *this;
@@ -175,7 +180,8 @@ Matrix& Matrix::operator/=(const double value)
 
 // =============================================================== //
 // Indexing operator
-double* Matrix::operator[](unsigned int i) const
+template <class T>
+T* BasicMatrix<T>::operator[](unsigned int i) const
 {
 	if(i >= this->rows)
 		throw std::invalid_argument("Index out of bounds");
@@ -185,7 +191,8 @@ double* Matrix::operator[](unsigned int i) const
 
 // =============================================================== //
 // Matrix functions
-Matrix Matrix::exp(const double tol) const
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::exp(const double tol) const
 {
 	if(this->rows != this->cols)
 		throw std::invalid_argument("Matrix exponential only defined for square matrices");
@@ -208,8 +215,8 @@ Matrix Matrix::exp(const double tol) const
 	int N = 30; 
 
 	// Do exponentiation through Horners scheme
-	Matrix I = Matrix::eye(this->rows);
-	Matrix res = I;
+	BasicMatrix I = BasicMatrix::eye(this->rows);
+	BasicMatrix res = I;
 
 	for(int i=N; i>0; i--){
 		res *= *this;
@@ -220,27 +227,117 @@ Matrix Matrix::exp(const double tol) const
 	return res;
 }
 
-Matrix Matrix::transpose() const
+// Transpose tiles. BLOCK x BLOCK blocks fit in L1 for both source and
+// destination, TILE x TILE micro tiles have constant bounds so the
+// compiler can fully unroll them into vector loads and stores.
+static const unsigned int TRANSPOSE_BLOCK = 64;
+static const unsigned int TRANSPOSE_TILE = 8;
+
+// dst[j][i] = src[i][j] for i in [r0, r1), j in [c0, c1)
+template <class T>
+static void transposeBlock(
+	const T* src, T* dst,
+	unsigned int r0, unsigned int r1,
+	unsigned int c0, unsigned int c1,
+	unsigned int srcCols, unsigned int dstCols)
 {
-	Matrix m(this->cols, this->rows);
+	unsigned int i = r0;
+	for (; i + TRANSPOSE_TILE <= r1; i += TRANSPOSE_TILE){
+		unsigned int j = c0;
+		for (; j + TRANSPOSE_TILE <= c1; j += TRANSPOSE_TILE){
+			for (unsigned int jj=0; jj<TRANSPOSE_TILE; jj++){
+				#pragma GCC ivdep
+				for (unsigned int ii=0; ii<TRANSPOSE_TILE; ii++){
+					dst[(j+jj)*dstCols + i+ii] = src[(i+ii)*srcCols + j+jj];
+				}
+			}
+		}
+		// Remaining columns of this row strip
+		for (; j < c1; j++){
+			for (unsigned int ii=0; ii<TRANSPOSE_TILE; ii++){
+				dst[j*dstCols + i+ii] = src[(i+ii)*srcCols + j];
+			}
+		}
+	}
+	// Remaining rows
+	for (; i < r1; i++){
+		for (unsigned int j=c0; j<c1; j++){
+			dst[j*dstCols + i] = src[i*srcCols + j];
+		}
+	}
+}
 
-	#pragma omp parallel for
-	for(unsigned int i=0; i<this->rows; i++){
-		#pragma GCC ivdep
-		for(unsigned int j=0; j<this->cols; j++){
-			m[j][i] = (*this)[i][j];
+template <class T>
+BasicMatrix<T> BasicMatrix<T>::transpose() const
+{
+	BasicMatrix m(this->cols, this->rows);
+
+	#pragma omp parallel for schedule(static)
+	for(unsigned int i=0; i<this->rows; i+=TRANSPOSE_BLOCK){
+		unsigned int iend = std::min(i + TRANSPOSE_BLOCK, this->rows);
+		for(unsigned int j=0; j<this->cols; j+=TRANSPOSE_BLOCK){
+			unsigned int jend = std::min(j + TRANSPOSE_BLOCK, this->cols);
+			transposeBlock(this->array, m.array, i, iend, j, jend, this->cols, this->rows);
 		}
 	}
 	return m;
 }
 
-double Matrix::norm() const 
+template <class T>
+BasicMatrix<T>& BasicMatrix<T>::transposeInPlace()
+{
+	if(this->rows != this->cols)
+		throw std::invalid_argument("In-place transpose only defined for square matrices");
+
+	const unsigned int n = this->rows;
+
+	// Swap block (i, j) with block (j, i) above the diagonal, blocks on
+	// the diagonal are transposed within themselves.
+	#pragma omp parallel for schedule(dynamic)
+	for(unsigned int i=0; i<n; i+=TRANSPOSE_BLOCK){
+		unsigned int iend = std::min(i + TRANSPOSE_BLOCK, n);
+
+		for(unsigned int r=i; r<iend; r++){
+			for(unsigned int c=r+1; c<iend; c++){
+				std::swap(this->array[r*n + c], this->array[c*n + r]);
+			}
+		}
+
+		for(unsigned int j=iend; j<n; j+=TRANSPOSE_BLOCK){
+			unsigned int jend = std::min(j + TRANSPOSE_BLOCK, n);
+			for(unsigned int r=i; r<iend; r++){
+				#pragma GCC ivdep
+				for(unsigned int c=j; c<jend; c++){
+					std::swap(this->array[r*n + c], this->array[c*n + r]);
+				}
+			}
+		}
+	}
+	return *this;
+}
+
+template <class T>
+BasicColMajorView<const T> BasicMatrix<T>::transposeView() const
+{
+	BasicColMajorView<const T> view = {this->array, this->cols, this->rows};
+	return view;
+}
+
+template <class T>
+BasicColMajorView<T> BasicMatrix<T>::transposeView()
+{
+	BasicColMajorView<T> view = {this->array, this->cols, this->rows};
+	return view;
+}
+
+template <class T>
+double BasicMatrix<T>::norm() const 
 {
 	double res = 0;
 
 	#pragma omp parallel for reduction(+:res)
 	for (unsigned long i=0; i<this->rows*this->cols; i++){
-		res += this->array[i]*this->array[i];
+		res += (double)this->array[i]*this->array[i];
 	}
 
 	return sqrt(res);
@@ -248,7 +345,8 @@ double Matrix::norm() const
 
 // =============================================================== //
 // Helpful stuff
-void Matrix::print() const
+template <class T>
+void BasicMatrix<T>::print() const
 {
 
 	printf("%dx%d -> [\n", this->rows, this->cols);
@@ -264,8 +362,9 @@ void Matrix::print() const
 	printf("]\n");
 }
 
-void Matrix::fillMatrix(
-	double array[],
+template <class T>
+void BasicMatrix<T>::fillMatrix(
+	T array[],
 	unsigned int lx,
 	unsigned int ly,
 	unsigned int ox,
@@ -278,20 +377,29 @@ void Matrix::fillMatrix(
 	}
 }
 
-inline unsigned int Matrix::index(unsigned int i, unsigned int j) const
+template <class T>
+inline unsigned int BasicMatrix<T>::index(unsigned int i, unsigned int j) const
 {
 	return i * this->cols + j;
 }
 
-double* Matrix::getArray() const
+template <class T>
+T* BasicMatrix<T>::getArray() const
 {
 	return this->array;
 }
 
-unsigned Matrix::getRows() const {
+template <class T>
+unsigned BasicMatrix<T>::getRows() const {
 	return rows;
 }
 
-unsigned Matrix::getCols() const {
+template <class T>
+unsigned BasicMatrix<T>::getCols() const {
 	return cols;
-}
\ No newline at end of file
+}
+
+template class BasicMatrix<double>;
+template class BasicMatrix<float>;
+template BasicMatrix<double>::BasicMatrix(const BasicMatrix<float>&);
+template BasicMatrix<float>::BasicMatrix(const BasicMatrix<double>&);
@@ -1,47 +1,86 @@
 #ifndef MATRIX_HPP
 #define MATRIX_HPP
 
+// Column-major view of a buffer, element (i, j) lives at data[i + j*rows].
+// This is the layout r8lib expects. Viewing the storage of a row-major
+// Matrix this way gives its transpose without moving any data.
+template <class T>
+struct BasicColMajorView {
+	T* data;
+	unsigned int rows;
+	unsigned int cols;
+
+	T& operator()(unsigned int i, unsigned int j) const { return data[i + j*rows]; }
+};
+
+typedef BasicColMajorView<double> ColMajorView;
+typedef BasicColMajorView<const double> ConstColMajorView;
 
-class Matrix {
+// Row-major matrix of T. Instantiated for double (Matrix) and float
+// (FMatrix), float halves the memory traffic where the precision allows.
+template <class T>
+class BasicMatrix {
 public:
-	static Matrix eye(const unsigned int);
-	static Matrix random(const unsigned int);
-	static Matrix random(const unsigned int, const unsigned int);
-
-	Matrix(int m);
-	Matrix(int m, int n);
-	Matrix(const Matrix&);
-	~Matrix();
-	Matrix& operator=(const Matrix&);
-	Matrix& operator+=(const Matrix&);
-	Matrix& operator+=(const double);
-	Matrix& operator-=(const Matrix&);
-	friend Matrix operator+(const Matrix&, const Matrix&);
-	friend Matrix operator-(const Matrix&, const Matrix&);
-	Matrix& operator*=(const Matrix&);
-	friend Matrix operator*(const Matrix&, const Matrix&);
-	Matrix& operator*=(const double);
-	Matrix& operator/=(const double);
-
-	double* operator[](unsigned int i) const;
-	Matrix exp(const double tol=1e-10) const;
-	Matrix transpose() const;
+	typedef T value_type;
+
+	static BasicMatrix eye(const unsigned int);
+	static BasicMatrix random(const unsigned int);
+	static BasicMatrix random(const unsigned int, const unsigned int);
+
+	BasicMatrix(int m);
+	BasicMatrix(int m, int n);
+	BasicMatrix(const BasicMatrix&);
+	// Conversion between precisions, every element is rounded to T
+	template <class U>
+	explicit BasicMatrix(const BasicMatrix<U>&);
+	~BasicMatrix();
+	BasicMatrix& operator=(const BasicMatrix&);
+	BasicMatrix& operator+=(const BasicMatrix&);
+	BasicMatrix& operator+=(const T);
+	BasicMatrix& operator-=(const BasicMatrix&);
+	friend BasicMatrix operator+(const BasicMatrix& m1, const BasicMatrix& m2) {
+		BasicMatrix m(m1);
+		m += m2;
+		return m;
+	}
+	friend BasicMatrix operator-(const BasicMatrix& m1, const BasicMatrix& m2) {
+		BasicMatrix m(m1);
+		m -= m2;
+		return m;
+	}
+	BasicMatrix& operator*=(const BasicMatrix&);
+	friend BasicMatrix operator*(const BasicMatrix& m1, const BasicMatrix& m2) {
+		BasicMatrix m(m1);
+		m *= m2;
+		return m;
+	}
+	BasicMatrix& operator*=(const T);
+	BasicMatrix& operator/=(const T);
+
+	T* operator[](unsigned int i) const;
+	BasicMatrix exp(const double tol=1e-10) const;
+	BasicMatrix transpose() const;
+	BasicMatrix& transposeInPlace();
+	// The const overload views read-only storage, the other one is for
+	// r8lib routines that work in place.
+	BasicColMajorView<const T> transposeView() const;
+	BasicColMajorView<T> transposeView();
 	double norm() const;
 	void print() const;
 	void fillMatrix(
-		double array[],
+		T array[],
 		unsigned int lx,
 		unsigned int ly,
 		unsigned int ox,
 		unsigned int oy);
 
-	double* getArray() const;
+	T* getArray() const;
 	unsigned getRows() const;
 	unsigned getCols() const;
 
 private:
 
-	double* array;
+	T* array;
 	unsigned int rows;
 	unsigned int cols;
 
@@ -49,4 +88,7 @@ private:
 
 };
 
+typedef BasicMatrix<double> Matrix;
+typedef BasicMatrix<float> FMatrix;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#ifndef TRIDIAGONAL_HPP
+#define TRIDIAGONAL_HPP
+
+#include "Matrix.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+// Batched solves of tridiagonal systems along the lines of a row-major
+// array, every row or every column being a system of its own, as in
+// compact difference schemes, implicit smoothers and ADI sweeps. The
+// Thomas algorithm runs on many systems side by side, so every step of
+// the elimination is one vector operation across them, and the batch is
+// split across OpenMP threads. Columns of a row-major array are side by
+// side already and are solved in strips of TRIDIAG_STRIP; rows are
+// interleaved TRIDIAG_LANES at a time into a small buffer first.
+//
+// There is no pivoting, the matrix needs to allow elimination in order,
+// as diagonally dominant ones do; a zero pivot throws invalid_argument
+// when it is factored. Element k of a line is x[k] for a row and x[k*ld]
+// for a column, ld being the row length of the array.
+
+// Rows interleaved into one buffer, columns solved together
+static const int TRIDIAG_LANES = 8;
+static const int TRIDIAG_STRIP = 256;
+
+// One n x n matrix for all lines, factored once: lower diagonal a
+// (a[0] unused), diagonal b and upper diagonal c (c[n-1] unused).
+class Tridiagonal {
+public:
+	Tridiagonal(int n, const double a[], const double b[], const double c[]);
+
+	int size() const { return (int)p.size(); }
+
+	// count rows of n values, ld apart, solved in place
+	template <class T>
+	void solve_rows(T x[], int count, int ld) const;
+	// count columns of n values, side by side in rows ld apart
+	template <class T>
+	void solve_columns(T x[], int count, int ld) const;
+
+	// Every row (size() == cols) or column (size() == rows) of m
+	template <class T>
+	void solve_rows(BasicMatrix<T>& m) const;
+	template <class T>
+	void solve_columns(BasicMatrix<T>& m) const;
+
+private:
+	// Lower diagonal, upper diagonal after elimination, inverse pivots
+	std::vector<double> a, u, p;
+
+	// w systems side by side, element k of system l at x[k*ld + l]
+	template <class T>
+	void solve_lanes(T x[], int w, size_t ld) const;
+};
+
+inline Tridiagonal::Tridiagonal(int n, const double a_[], const double b[], const double c[])
+	: a(n), u(n), p(n)
+{
+	if (n <= 0)
+		throw std::invalid_argument("Tridiagonal system must have a positive size");
+	for (int k = 0; k < n; k++){
+		a[k] = k > 0 ? a_[k] : 0.0;
+		const double pivot = b[k] - (k > 0 ? a[k] * u[k-1] : 0.0);
+		if (pivot == 0.0)
+			throw std::invalid_argument("Tridiagonal system needs pivoting");
+		p[k] = 1.0 / pivot;
+		u[k] = k < n - 1 ? c[k] * p[k] : 0.0;
+	}
+}
+
+template <class T>
+void Tridiagonal::solve_lanes(T x[], int w, size_t ld) const
+{
+	const int n = size();
+	const T p0 = (T)p[0];
+	#pragma omp simd
+	for (int l = 0; l < w; l++)
+		x[l] *= p0;
+	for (int k = 1; k < n; k++){
+		T* cur = x + k*ld;
+		const T* prev = cur - ld;
+		const T ak = (T)a[k], pk = (T)p[k];
+		#pragma omp simd
+		for (int l = 0; l < w; l++)
+			cur[l] = (cur[l] - ak * prev[l]) * pk;
+	}
+	for (int k = n - 2; k >= 0; k--){
+		T* cur = x + k*ld;
+		const T* next = cur + ld;
+		const T uk = (T)u[k];
+		#pragma omp simd
+		for (int l = 0; l < w; l++)
+			cur[l] -= uk * next[l];
+	}
+}
+
+template <class T>
+void Tridiagonal::solve_rows(T x[], int count, int ld) const
+{
+	const int n = size();
+	const int groups = (count + TRIDIAG_LANES - 1) / TRIDIAG_LANES;
+
+	#pragma omp parallel
+	{
+		std::vector<T> buf((size_t)n * TRIDIAG_LANES);
+
+		#pragma omp for schedule(static)
+		for (int g = 0; g < groups; g++){
+			const int r0 = g * TRIDIAG_LANES;
+			const int w = std::min(TRIDIAG_LANES, count - r0);
+			for (int l = 0; l < w; l++){
+				const T* row = x + (size_t)(r0 + l)*ld;
+				for (int k = 0; k < n; k++)
+					buf[k*TRIDIAG_LANES + l] = row[k];
+			}
+			solve_lanes(buf.data(), TRIDIAG_LANES, TRIDIAG_LANES);
+			for (int l = 0; l < w; l++){
+				T* row = x + (size_t)(r0 + l)*ld;
+				for (int k = 0; k < n; k++)
+					row[k] = buf[k*TRIDIAG_LANES + l];
+			}
+		}
+	}
+}
+
+template <class T>
+void Tridiagonal::solve_columns(T x[], int count, int ld) const
+{
+	#pragma omp parallel for schedule(static)
+	for (int j0 = 0; j0 < count; j0 += TRIDIAG_STRIP)
+		solve_lanes(x + j0, std::min(TRIDIAG_STRIP, count - j0), ld);
+}
+
+template <class T>
+void Tridiagonal::solve_rows(BasicMatrix<T>& m) const
+{
+	if ((int)m.getCols() != size())
+		throw std::invalid_argument("Rows and tridiagonal system differ in size");
+	solve_rows(m.getArray(), m.getRows(), m.getCols());
+}
+
+template <class T>
+void Tridiagonal::solve_columns(BasicMatrix<T>& m) const
+{
+	if ((int)m.getRows() != size())
+		throw std::invalid_argument("Columns and tridiagonal system differ in size");
+	solve_columns(m.getArray(), m.getCols(), m.getCols());
+}
+
+#endif
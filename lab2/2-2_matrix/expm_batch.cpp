@@ -0,0 +1,37 @@
+#include "expm_batch.hpp"
+#include <cmath>
+#include <vector>
+#include <stdexcept>
+
+#include "r8mat_expm1.h"
+
+void expm_batch(int n, int count, const double a[], double out[])
+{
+	if (n <= 0 || count < 0)
+		throw std::invalid_argument("Matrix size must be positive and count non-negative");
+
+	switch (n) {
+	case 1:
+		#pragma omp parallel for schedule(static)
+		for (int b = 0; b < count; b++)
+			out[b] = std::exp(a[b]);
+		return;
+	case 2: expm_batch<2>(count, a, out); return;
+	case 3: expm_batch<3>(count, a, out); return;
+	case 4: expm_batch<4>(count, a, out); return;
+	case 5: expm_batch<5>(count, a, out); return;
+	case 6: expm_batch<6>(count, a, out); return;
+	case 7: expm_batch<7>(count, a, out); return;
+	case 8: expm_batch<8>(count, a, out); return;
+	}
+
+	// Larger matrices: one r8mat_expm1 workspace per thread
+	#pragma omp parallel
+	{
+		std::vector<double> work(r8mat_expm1_work_size(n));
+
+		#pragma omp for schedule(static)
+		for (int b = 0; b < count; b++)
+			r8mat_expm1(n, const_cast<double*>(a + (size_t)b*n*n), out + (size_t)b*n*n, work.data());
+	}
+}
@@ -0,0 +1,210 @@
+#ifndef EXPM_BATCH_HPP
+#define EXPM_BATCH_HPP
+
+#include <cmath>
+
+// Matrix exponential of many small matrices stored back to back, i.e.
+// matrix b occupies a[b*n*n .. (b+1)*n*n). Since exp(A^T) = exp(A)^T
+// the batch can be row-major (Matrix) or column-major (r8lib) as long as
+// the output is read the same way.
+//
+// Same algorithm as r8mat_expm1: scaling and squaring with a (6,6) Pade
+// approximant, but with the size fixed at compile time so all loops are
+// unrolled, and EXPM_LANES matrices processed side by side so every
+// operation is a vector operation across the batch.
+void expm_batch(int n, int count, const double a[], double out[]);
+
+template <int N>
+void expm_batch(int count, const double a[], double out[]);
+
+// Number of matrices interleaved in one kernel call
+static const int EXPM_LANES = 4;
+
+// Kernel on W interleaved matrices: element (i, j) of matrix l is at
+// a[(i*N + j)*W + l].
+template <int N, int W>
+void expm_pade_lanes(const double a[], double e[])
+{
+	const int q = 6;
+	double a2[N*N*W], x[N*N*W], d[N*N*W], tmp[N*N*W];
+	double t[W];
+	int s[W];
+	int smax = 0;
+
+	// Scale by 2^-s so that ||A||_inf <= 1/2, as in r8mat_expm1
+	for (int l = 0; l < W; l++){
+		double a_norm = 0.0;
+		for (int i = 0; i < N; i++){
+			double row_sum = 0.0;
+			for (int j = 0; j < N; j++)
+				row_sum += std::fabs(a[(i*N + j)*W + l]);
+			a_norm = row_sum > a_norm ? row_sum : a_norm;
+		}
+		s[l] = (a_norm > 0.0) ? (int)(std::log2(a_norm)) + 2 : 0;
+		if (s[l] < 0) s[l] = 0;
+		t[l] = std::ldexp(1.0, -s[l]);
+		smax = s[l] > smax ? s[l] : smax;
+	}
+
+	double c = 0.5;
+	for (int i = 0; i < N; i++){
+		for (int j = 0; j < N; j++){
+			const double id = (i == j) ? 1.0 : 0.0;
+			#pragma GCC ivdep
+			for (int l = 0; l < W; l++){
+				const int k = (i*N + j)*W + l;
+				a2[k] = a[k] * t[l];
+				x[k] = a2[k];
+				e[k] = id + c * a2[k];
+				d[k] = id - c * a2[k];
+			}
+		}
+	}
+
+	double sign = 1.0;
+	for (int p = 2; p <= q; p++){
+		c = c * (double)(q - p + 1) / (double)(p * (2*q - p + 1));
+
+		// x = a2 * x
+		for (int i = 0; i < N; i++){
+			for (int j = 0; j < N; j++){
+				double acc[W] = {};
+				for (int k = 0; k < N; k++){
+					#pragma GCC ivdep
+					for (int l = 0; l < W; l++)
+						acc[l] += a2[(i*N + k)*W + l] * x[(k*N + j)*W + l];
+				}
+				for (int l = 0; l < W; l++)
+					tmp[(i*N + j)*W + l] = acc[l];
+			}
+		}
+
+		#pragma GCC ivdep
+		for (int k = 0; k < N*N*W; k++){
+			x[k] = tmp[k];
+			e[k] += c * x[k];
+			d[k] += sign * c * x[k];
+		}
+		sign = -sign;
+	}
+
+	// e = inverse(d) * e. With ||A|| <= 1/2, d is strictly diagonally
+	// dominant, so elimination without pivoting is safe and every lane
+	// follows the same path.
+	for (int p = 0; p < N; p++){
+		for (int r = p + 1; r < N; r++){
+			double f[W];
+			#pragma GCC ivdep
+			for (int l = 0; l < W; l++)
+				f[l] = d[(r*N + p)*W + l] / d[(p*N + p)*W + l];
+			for (int col = p + 1; col < N; col++){
+				#pragma GCC ivdep
+				for (int l = 0; l < W; l++)
+					d[(r*N + col)*W + l] -= f[l] * d[(p*N + col)*W + l];
+			}
+			for (int col = 0; col < N; col++){
+				#pragma GCC ivdep
+				for (int l = 0; l < W; l++)
+					e[(r*N + col)*W + l] -= f[l] * e[(p*N + col)*W + l];
+			}
+		}
+	}
+	for (int r = N - 1; r >= 0; r--){
+		for (int col = 0; col < N; col++){
+			for (int k = r + 1; k < N; k++){
+				#pragma GCC ivdep
+				for (int l = 0; l < W; l++)
+					e[(r*N + col)*W + l] -= d[(r*N + k)*W + l] * e[(k*N + col)*W + l];
+			}
+			#pragma GCC ivdep
+			for (int l = 0; l < W; l++)
+				e[(r*N + col)*W + l] /= d[(r*N + r)*W + l];
+		}
+	}
+
+	// e = e^(2^s), lanes with a smaller s keep their value
+	for (int p = 0; p < smax; p++){
+		for (int i = 0; i < N; i++){
+			for (int j = 0; j < N; j++){
+				double acc[W] = {};
+				for (int k = 0; k < N; k++){
+					#pragma GCC ivdep
+					for (int l = 0; l < W; l++)
+						acc[l] += e[(i*N + k)*W + l] * e[(k*N + j)*W + l];
+				}
+				for (int l = 0; l < W; l++)
+					tmp[(i*N + j)*W + l] = acc[l];
+			}
+		}
+		#pragma GCC ivdep
+		for (int k = 0; k < N*N; k++){
+			for (int l = 0; l < W; l++)
+				e[k*W + l] = (p < s[l]) ? tmp[k*W + l] : e[k*W + l];
+		}
+	}
+}
+
+// Closed form for 2x2: with m = tr(A)/2 and B = A - m*I, B^2 = delta*I,
+// so exp(A) = e^m * (cosh(sqrt(delta))*I + sinh(sqrt(delta))/sqrt(delta) * B).
+inline void expm_2x2(const double a[], double e[])
+{
+	const double m = 0.5 * (a[0] + a[3]);
+	const double h = 0.5 * (a[0] - a[3]);
+	const double delta = h*h + a[1]*a[2];
+	const double em = std::exp(m);
+
+	double ch, sh;
+	if (delta > 0.0){
+		const double r = std::sqrt(delta);
+		ch = std::cosh(r);
+		sh = std::sinh(r) / r;
+	} else if (delta < 0.0){
+		const double r = std::sqrt(-delta);
+		ch = std::cos(r);
+		sh = std::sin(r) / r;
+	} else {
+		ch = 1.0;
+		sh = 1.0;
+	}
+
+	e[0] = em * (ch + sh * h);
+	e[1] = em * sh * a[1];
+	e[2] = em * sh * a[2];
+	e[3] = em * (ch - sh * h);
+}
+
+template <int N>
+void expm_batch(int count, const double a[], double out[])
+{
+	const int groups = count / EXPM_LANES;
+
+	#pragma omp parallel for schedule(static)
+	for (int g = 0; g < groups; g++){
+		double in[N*N*EXPM_LANES], res[N*N*EXPM_LANES];
+		const double* src = a + (size_t)g*EXPM_LANES*N*N;
+		double* dst = out + (size_t)g*EXPM_LANES*N*N;
+
+		for (int l = 0; l < EXPM_LANES; l++)
+			for (int k = 0; k < N*N; k++)
+				in[k*EXPM_LANES + l] = src[l*N*N + k];
+
+		expm_pade_lanes<N, EXPM_LANES>(in, res);
+
+		for (int l = 0; l < EXPM_LANES; l++)
+			for (int k = 0; k < N*N; k++)
+				dst[l*N*N + k] = res[k*EXPM_LANES + l];
+	}
+
+	for (int b = groups*EXPM_LANES; b < count; b++)
+		expm_pade_lanes<N, 1>(a + (size_t)b*N*N, out + (size_t)b*N*N);
+}
+
+template <>
+inline void expm_batch<2>(int count, const double a[], double out[])
+{
+	#pragma omp parallel for schedule(static)
+	for (int b = 0; b < count; b++)
+		expm_2x2(a + 4*(size_t)b, out + 4*(size_t)b);
+}
+
+#endif
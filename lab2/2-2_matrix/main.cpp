@@ -1,10 +1,44 @@
 #include "Matrix.hpp"
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 #include <ctime>
+#include <vector>
 
 using namespace std;
-#include "r8mat_expm1.h"
+#include "r8interop.hpp"
+#include "expm_batch.hpp"
+#include "Tridiagonal.hpp"
+#include "FixedMatrix.hpp"
+
+// FixedMatrix arithmetic is constexpr, checked by the compiler. The
+// entries are chosen so every result is exact in double.
+constexpr FixedMatrix<2, 2> fixed_sample()
+{
+	FixedMatrix<2, 2> m;
+	m[0][0] = 2.0; m[0][1] = 1.0;
+	m[1][0] = 2.0; m[1][1] = 3.0;
+	return m;
+}
+
+constexpr FixedMatrix<3, 3> fixed_sample3()
+{
+	FixedMatrix<3, 3> m = FixedMatrix<3, 3>::eye() * 2.0;
+	m[0][2] = 1.0; m[1][0] = 1.0; m[2][1] = 1.0;
+	return m;
+}
+
+static_assert(FixedMatrix<3, 3>::eye()[1][1] == 1.0 && FixedMatrix<3, 3>::eye()[1][2] == 0.0,
+	"eye");
+static_assert(fixed_sample().det() == 4.0, "2x2 det");
+static_assert(fixed_sample3().det() == 9.0, "3x3 det");
+static_assert((FixedMatrix<4, 4>::eye() * 2.0).det() == 16.0, "LU det");
+static_assert((fixed_sample() * fixed_sample())[1][0] == 10.0, "product");
+static_assert(fixed_sample().inverse()[0][1] == -0.25, "2x2 inverse");
+static_assert((fixed_sample() * fixed_sample().inverse())[0][0] == 1.0
+	&& (fixed_sample() * fixed_sample().inverse())[1][0] == 0.0, "product with inverse");
+static_assert((fixed_sample3() * fixed_sample3().inverse())[2][2] == 1.0, "3x3 inverse");
 
 
 int main(int argc, char const *argv[])
@@ -13,7 +47,6 @@ int main(int argc, char const *argv[])
 	srand(time(0));
 	int dim = 5;
 
-	double* exp;
 	Matrix res(dim);
 
 	Matrix mat = Matrix::random(dim);
@@ -21,13 +54,58 @@ int main(int argc, char const *argv[])
 
 	printf("Matrix.exp()\n");
 	mat.exp().print();
-	printf("r8mat_expm1\n");
-	exp = r8mat_expm1 ( dim, mat.transpose().getArray() );
-	res.fillMatrix(exp, dim, dim, 0, 0);
-	res.transpose().print();
-	Matrix diff = mat.exp()-res.transpose();
+	printf("view_expm1\n");
+	view_expm1(mat, res);
+	res.print();
+	Matrix diff = mat.exp()-res;
 	printf("Norm diff exp: %f\n", diff.norm());
 	diff.print();
 
+	// More matrices than EXPM_LANES so both the interleaved groups and the
+	// tail run, and a 2x2 batch for the closed form. Matrix b of a batch
+	// is rows b*n .. (b+1)*n-1, each against r8mat_expm1 on the same array.
+	printf("expm_batch\n");
+	const int count = 2*EXPM_LANES + 1;
+	const int sizes[] = {2, dim};
+	for (int s = 0; s < 2; s++){
+		const int n = sizes[s];
+		Matrix batch = Matrix::random(count*n, n);
+		Matrix batch_exp(count*n, n);
+		expm_batch(n, count, batch.getArray(), batch_exp.getArray());
+
+		vector<double> ref(n*n), ref_work(r8mat_expm1_work_size(n));
+		double largest = 0.0;
+		for (int b = 0; b < count; b++){
+			r8mat_expm1(n, batch.getArray() + b*n*n, ref.data(), ref_work.data());
+			for (int k = 0; k < n*n; k++)
+				largest = max(largest, fabs(batch_exp.getArray()[b*n*n + k] - ref[k]));
+		}
+		printf("Max diff batch of %d %dx%d: %e\n", count, n, n, largest);
+	}
+
+	printf("FixedMatrix::exp()\n");
+	Matrix small = Matrix::random(3);
+	const Matrix fixed_exp = FixedMatrix<3, 3>(small).exp().toMatrix();
+	printf("Norm diff fixed exp: %e\n", (fixed_exp-small.exp()).norm());
+
+	// Diagonally dominant tridiagonal matrix, every column of rhs a system
+	printf("Tridiagonal\n");
+	vector<double> lower(dim), diag(dim), upper(dim);
+	Matrix tri(dim, dim);
+	for (int k = 0; k < dim; k++){
+		lower[k] = (double)rand() / RAND_MAX;
+		upper[k] = (double)rand() / RAND_MAX;
+		diag[k] = 2.0 + lower[k] + upper[k];
+		for (int j = 0; j < dim; j++)
+			tri[k][j] = (j == k) ? diag[k] : (j == k - 1) ? lower[k] : (j == k + 1) ? upper[k] : 0.0;
+	}
+	Matrix rhs = Matrix::random(dim, 3);
+	Matrix sol(dim, 3);
+	vector<double> work(dim * (dim + 3));
+	view_solve(tri, rhs, sol, work.data());
+	Matrix cols(rhs);
+	Tridiagonal(dim, lower.data(), diag.data(), upper.data()).solve_columns(cols);
+	printf("Norm diff tridiagonal: %e\n", (cols-sol).norm());
+
 	return 0;
 }
\ No newline at end of file
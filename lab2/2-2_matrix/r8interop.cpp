@@ -0,0 +1,154 @@
+#include "r8interop.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+#include "r8lib.h"
+
+// =============================================================== //
+// Views
+
+MatrixView::MatrixView(double* data, unsigned int rows, unsigned int cols, Layout layout)
+: data(data), rows(rows), cols(cols), layout(layout) {}
+
+MatrixView::MatrixView(Matrix& matrix)
+: MatrixView(matrix.getArray(), matrix.getRows(), matrix.getCols(), Layout::RowMajor) {}
+
+MatrixView::MatrixView(const ColMajorView& view)
+: MatrixView(view.data, view.rows, view.cols, Layout::ColMajor) {}
+
+MatrixView MatrixView::transposed() const
+{
+	Layout other = (this->layout == Layout::RowMajor) ? Layout::ColMajor : Layout::RowMajor;
+	return MatrixView(this->data, this->cols, this->rows, other);
+}
+
+ConstMatrixView::ConstMatrixView(const double* data, unsigned int rows, unsigned int cols, Layout layout)
+: data(data), rows(rows), cols(cols), layout(layout) {}
+
+ConstMatrixView::ConstMatrixView(const Matrix& matrix)
+: ConstMatrixView(matrix.getArray(), matrix.getRows(), matrix.getCols(), Layout::RowMajor) {}
+
+ConstMatrixView::ConstMatrixView(const MatrixView& view)
+: ConstMatrixView(view.data, view.rows, view.cols, view.layout) {}
+
+ConstMatrixView::ConstMatrixView(const ColMajorView& view)
+: ConstMatrixView(view.data, view.rows, view.cols, Layout::ColMajor) {}
+
+ConstMatrixView::ConstMatrixView(const ConstColMajorView& view)
+: ConstMatrixView(view.data, view.rows, view.cols, Layout::ColMajor) {}
+
+ConstMatrixView ConstMatrixView::transposed() const
+{
+	Layout other = (this->layout == Layout::RowMajor) ? Layout::ColMajor : Layout::RowMajor;
+	return ConstMatrixView(this->data, this->cols, this->rows, other);
+}
+
+// =============================================================== //
+// Kernels
+
+void view_copy(ConstMatrixView src, MatrixView dst)
+{
+	if (src.rows != dst.rows || src.cols != dst.cols)
+		throw std::invalid_argument("Size of matrices does not align");
+
+	if (src.layout == dst.layout){
+		if (src.data != dst.data)
+			memcpy(dst.data, src.data, sizeof(double)*src.rows*src.cols);
+		return;
+	}
+
+	if (src.data == dst.data)
+		throw std::invalid_argument("Layout conversion can not be done in place");
+
+	// Walk dst contiguously
+	if (dst.layout == Layout::RowMajor){
+		for (unsigned int i = 0; i < dst.rows; i++)
+			for (unsigned int j = 0; j < dst.cols; j++)
+				dst.data[i*dst.cols + j] = src(i, j);
+	} else {
+		for (unsigned int j = 0; j < dst.cols; j++)
+			for (unsigned int i = 0; i < dst.rows; i++)
+				dst.data[i + j*dst.rows] = src(i, j);
+	}
+}
+
+void view_mm(ConstMatrixView a, ConstMatrixView b, MatrixView c)
+{
+	if (a.cols != b.rows)
+		throw std::invalid_argument("Second dimension of first matrix does not match first dimension of second matrix.");
+	if (c.rows != a.rows || c.cols != b.cols)
+		throw std::invalid_argument("Size of output matrix does not align");
+	if (c.data == a.data || c.data == b.data)
+		throw std::invalid_argument("Output matrix can not alias an input");
+
+	// Mixed layouts: inputs are copied into the layout of c, so the
+	// product is always one blocked gemm
+	std::vector<double> sa, sb;
+	if (a.layout != c.layout){
+		sa.resize((size_t)a.rows*a.cols);
+		view_copy(a, MatrixView(sa.data(), a.rows, a.cols, c.layout));
+		a = ConstMatrixView(sa.data(), a.rows, a.cols, c.layout);
+	}
+	if (b.layout != c.layout){
+		sb.resize((size_t)b.rows*b.cols);
+		view_copy(b, MatrixView(sb.data(), b.rows, b.cols, c.layout));
+		b = ConstMatrixView(sb.data(), b.rows, b.cols, c.layout);
+	}
+
+	if (c.layout == Layout::ColMajor)
+		r8mat_gemm(a.rows, a.cols, b.cols, a.data, b.data, c.data);
+	else
+		// Row-major storage is the column-major transpose: c^T = b^T * a^T
+		r8mat_gemm(b.cols, b.rows, a.rows, b.data, a.data, c.data);
+}
+
+void view_expm1(ConstMatrixView a, MatrixView out)
+{
+	const int n = a.rows;
+	std::vector<double> work(r8mat_expm1_work_size(n) + n*n);
+	view_expm1(a, out, work.data());
+}
+
+void view_expm1(ConstMatrixView a, MatrixView out, double work[])
+{
+	if (a.rows != a.cols)
+		throw std::invalid_argument("Matrix exponential only defined for square matrices");
+	if (out.rows != a.rows || out.cols != a.cols)
+		throw std::invalid_argument("Size of output matrix does not align");
+
+	// exp(A^T) = exp(A)^T, so the stored buffer can be handed over as is
+	// and the result read back in the layout of a.
+	// r8mat_expm1 only reads a, its r8lib signature just is not const
+	const int n = a.rows;
+	double* in = const_cast<double*>(a.data);
+	if (a.layout == out.layout){
+		r8mat_expm1(n, in, out.data, work);
+		return;
+	}
+	double* e = work + r8mat_expm1_work_size(n);
+	r8mat_expm1(n, in, e, work);
+	view_copy(ConstMatrixView(e, n, n, a.layout), out);
+}
+
+void view_solve(ConstMatrixView a, ConstMatrixView b, MatrixView x, double work[])
+{
+	if (a.rows != a.cols)
+		throw std::invalid_argument("Linear system needs a square matrix");
+	if (b.rows != a.rows || x.rows != b.rows || x.cols != b.cols)
+		throw std::invalid_argument("Size of matrices does not align");
+
+	// r8mat_solve reduces the augmented column-major matrix [A | B] in place
+	const int n = a.rows;
+	const int nrhs = b.cols;
+	view_copy(a, MatrixView(work, n, n, Layout::ColMajor));
+	view_copy(b, MatrixView(work + n*n, n, nrhs, Layout::ColMajor));
+
+	if (r8mat_solve(n, nrhs, work) != 0)
+		throw std::invalid_argument("Matrix is singular");
+
+	view_copy(ConstMatrixView(work + n*n, n, nrhs, Layout::ColMajor), x);
+}
@@ -0,0 +1,72 @@
+#ifndef R8INTEROP_HPP
+#define R8INTEROP_HPP
+
+#include "Matrix.hpp"
+#include "r8mat_expm1.h"
+
+// Thin adapter between Matrix (row-major) and the column-major r8lib
+// routines. Views never own memory, outputs are written into buffers
+// supplied by the caller.
+
+enum class Layout { RowMajor, ColMajor };
+
+// Writable view, for outputs
+struct MatrixView {
+	double* data;
+	unsigned int rows;
+	unsigned int cols;
+	Layout layout;
+
+	MatrixView(double* data, unsigned int rows, unsigned int cols, Layout layout);
+	MatrixView(Matrix&);
+	MatrixView(const ColMajorView&);
+
+	double& operator()(unsigned int i, unsigned int j) const {
+		return layout == Layout::RowMajor ? data[i*cols + j] : data[i + j*rows];
+	}
+
+	// Same storage read the other way round, i.e. the transpose.
+	MatrixView transposed() const;
+};
+
+// Read-only view, for inputs. Any MatrixView converts to one.
+struct ConstMatrixView {
+	const double* data;
+	unsigned int rows;
+	unsigned int cols;
+	Layout layout;
+
+	ConstMatrixView(const double* data, unsigned int rows, unsigned int cols, Layout layout);
+	ConstMatrixView(const Matrix&);
+	ConstMatrixView(const MatrixView&);
+	ConstMatrixView(const ColMajorView&);
+	ConstMatrixView(const ConstColMajorView&);
+
+	const double& operator()(unsigned int i, unsigned int j) const {
+		return layout == Layout::RowMajor ? data[i*cols + j] : data[i + j*rows];
+	}
+
+	ConstMatrixView transposed() const;
+};
+
+// The wrappers are named view_* so a call site shows it goes through
+// the views rather than the raw r8lib routines of the same purpose.
+
+// dst = src, converting layout if needed. Sizes must match.
+void view_copy(ConstMatrixView src, MatrixView dst);
+
+// c = a * b. c must not alias a or b. Inputs in another layout than c
+// are rearranged into scratch space first.
+void view_mm(ConstMatrixView a, ConstMatrixView b, MatrixView c);
+
+// out = exp(a).
+void view_expm1(ConstMatrixView a, MatrixView out);
+
+// out = exp(a) without allocating. work must hold r8mat_expm1_work_size(n)
+// doubles, plus n*n more when a and out have different layouts.
+void view_expm1(ConstMatrixView a, MatrixView out, double work[]);
+
+// x = inverse(a) * b. work must hold a.rows * (a.rows + b.cols) doubles.
+void view_solve(ConstMatrixView a, ConstMatrixView b, MatrixView x, double work[]);
+
+#endif
@@ -6,6 +6,7 @@
 # include <complex>
 # include <ctime>
 # include <cstring>
+# include <algorithm>
 
 using namespace std;
 
@@ -50,43 +51,115 @@ double *r8mat_expm1 ( int n, double a[] )
 //
 //    Output, double R8MAT_EXPM1[N*N], the estimate for exp(A).
 //
+{
+  double *e;
+  double *work;
+
+  e = new double[n*n];
+  work = new double[r8mat_expm1_work_size ( n )];
+
+  r8mat_expm1 ( n, a, e, work );
+
+  delete [] work;
+
+  return e;
+}
+//****************************************************************************80
+
+int r8mat_expm1_work_size ( int n )
+
+//****************************************************************************80
+//
+//  Purpose:
+//
+//    R8MAT_EXPM1_WORK_SIZE is the workspace length needed by R8MAT_EXPM1.
+//
+//  Parameters:
+//
+//    Input, int N, the dimension of the matrix.
+//
+//    Output, int R8MAT_EXPM1_WORK_SIZE, the number of doubles in WORK.
+//
+{
+  return 4 * n * n;
+}
+//****************************************************************************80
+
+void r8mat_expm1 ( int n, double a[], double e[], double work[] )
+
+//****************************************************************************80
+//
+//  Purpose:
+//
+//    R8MAT_EXPM1 computes exp(A) without allocating.
+//
+//  Discussion:
+//
+//    Same Pade approximation with scaling and squaring as the allocating
+//    version, but every intermediate lives in WORK, the products use the
+//    blocked R8MAT_GEMM kernel and D\E is solved in place by R8MAT_FSS.
+//    Calling it repeatedly with the same WORK performs no heap allocation.
+//
+//  Parameters:
+//
+//    Input, int N, the dimension of the matrix.
+//
+//    Input, double A[N*N], the matrix.
+//
+//    Output, double E[N*N], the estimate for exp(A).
+//
+//    Workspace, double WORK[R8MAT_EXPM1_WORK_SIZE(N)].
+//
 {
   double *a2;
   double a_norm;
   double c;
   double *d;
-  double *e;
+  double *e_out;
   int ee;
+  int i;
   int k;
   const double one = 1.0;
   int p;
   const int q = 6;
   int s;
   double t;
+  double *tmp;
+  double *swap;
   double *x;
 
-  a2 = r8mat_copy_new ( n, n, a );
+  a2  = work;
+  x   = work + n * n;
+  d   = work + 2 * n * n;
+  tmp = work + 3 * n * n;
+  e_out = e;
+
+  r8mat_copy ( n, n, a, a2 );
 
   a_norm = r8mat_norm_li ( n, n, a2 );
 
   ee = ( int ) ( r8_log_2 ( a_norm ) ) + 1;
-  
+
   s = i4_max ( 0, ee + 1 );
 
   t = 1.0 / pow ( 2.0, s );
 
   r8mat_scale ( n, n, t, a2 );
 
-  x = r8mat_copy_new ( n, n, a2 );
+  r8mat_copy ( n, n, a2, x );
 
   c = 0.5;
 
-  e = r8mat_identity_new ( n );
+  memset ( e, 0, sizeof ( double ) * n * n );
+  memset ( d, 0, sizeof ( double ) * n * n );
+  for ( i = 0; i < n; i++ )
+  {
+    e[i+i*n] = 1.0;
+    d[i+i*n] = 1.0;
+  }
 
   r8mat_add ( n, n, one, e, c, a2, e );
 
-  d = r8mat_identity_new ( n );
-
   r8mat_add ( n, n, one, d, -c, a2, d );
 
   p = 1;
@@ -95,7 +168,8 @@ double *r8mat_expm1 ( int n, double a[] )
   {
     c = c * ( double ) ( q - k + 1 ) / ( double ) ( k * ( 2 * q - k + 1 ) );
 
-    r8mat_mm ( n, n, n, a2, x, x );
+    r8mat_gemm ( n, n, n, a2, x, tmp );
+    swap = x; x = tmp; tmp = swap;
 
     r8mat_add ( n, n, c, x, one, e, e );
 
@@ -111,20 +185,77 @@ double *r8mat_expm1 ( int n, double a[] )
     p = !p;
   }
 //
-//  E -> inverse(D) * E
+//  E -> inverse(D) * E, D is overwritten by its LU factors.
 //
-  r8mat_minvm ( n, n, d, e, e );
+  r8mat_fss ( n, d, n, e );
 //
 //  E -> E^(2*S)
 //
   for ( k = 1; k <= s; k++ )
   {
-    r8mat_mm ( n, n, n, e, e, e );
+    r8mat_gemm ( n, n, n, e, e, tmp );
+    swap = e; e = tmp; tmp = swap;
   }
 
-  delete [] a2;
-  delete [] d;
-  delete [] x;
+  if ( e != e_out )
+  {
+    r8mat_copy ( n, n, e, e_out );
+  }
 
-  return e;
+  return;
+}
+//****************************************************************************80
+
+void r8mat_gemm ( int n1, int n2, int n3, const double a[], const double b[],
+  double c[] )
+
+//****************************************************************************80
+//
+//  Purpose:
+//
+//    R8MAT_GEMM computes C = A * B for column-major matrices.
+//
+//  Discussion:
+//
+//    The loop over K is blocked by GEMM_BLOCK, so a column block of A and
+//    the matching rows of B stay in L1 while a column of C is accumulated.
+//    Nothing is allocated. C must not overlap A or B.
+//
+//  Parameters:
+//
+//    Input, int N1, N2, N3, the order of the matrices.
+//
+//    Input, const double A[N1*N2], B[N2*N3], the factors.
+//
+//    Output, double C[N1*N3], the product A*B.
+//
+{
+  const int GEMM_BLOCK = 64;
+  int i;
+  int j;
+  int k;
+  int kk;
+  int kend;
+
+  memset ( c, 0, sizeof ( double ) * n1 * n3 );
+
+  #pragma omp parallel for private ( i, k, kk, kend ) if ( ( double ) n1 * n2 * n3 > 100000.0 )
+  for ( j = 0; j < n3; j++ )
+  {
+    for ( kk = 0; kk < n2; kk += GEMM_BLOCK )
+    {
+      kend = min ( kk + GEMM_BLOCK, n2 );
+      for ( k = kk; k < kend; k++ )
+      {
+        const double bkj = b[k+j*n2];
+        #pragma GCC ivdep
+        for ( i = 0; i < n1; i++ )
+        {
+          c[i+j*n1] = c[i+j*n1] + a[i+k*n1] * bkj;
+        }
+      }
+    }
+  }
+
+  return;
 }
@@ -2,3 +2,10 @@
 //  Real functions.
 //
 double *r8mat_expm1 ( int n, double a[] );
+int r8mat_expm1_work_size ( int n );
+void r8mat_expm1 ( int n, double a[], double e[], double work[] );
+//
+//  Column-major c(n1 x n3) = a(n1 x n2) * b(n2 x n3), blocked and
+//  allocation free. c must not alias a or b.
+//
+void r8mat_gemm ( int n1, int n2, int n3, const double a[], const double b[], double c[] );
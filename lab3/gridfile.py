@@ -0,0 +1,84 @@
+"""Reader for the binary grid files of Domain (toFile, toFileCompressed)
+and the FloatCodec runs they are coded in. lab4-linked/gfield.py builds
+its field and dataset readers on top of this module."""
+import numpy as np
+
+BLOCK = 32  # FloatCodec::BLOCK
+
+
+def _decode_ints(buf, n):
+    """Integers of one FloatCodec run of n values, as uint64."""
+    # zeros after the end stand in for the cut off tail of the last block
+    buf = np.concatenate((np.frombuffer(buf, dtype=np.uint8), np.zeros(8*BLOCK, dtype=np.uint8)))
+    first = buf[:8].view(np.uint64)[0]
+    blocks = (n - 1 + BLOCK - 1) // BLOCK
+    widths = buf[8:8+blocks].astype(np.int64)
+    lens = np.full(blocks, BLOCK)
+    lens[-1:] = n - 1 - (blocks - 1)*BLOCK
+    starts = 8 + blocks + np.concatenate(([0], np.cumsum((lens*widths + 7) // 8)[:-1])).astype(np.int64)
+
+    # unpack the blocks of each bit width together
+    z = np.zeros((blocks, BLOCK), dtype=np.uint64)
+    for w in np.unique(widths[widths > 0]):
+        sel = np.nonzero(widths == w)[0]
+        raw = buf[starts[sel][:, None] + np.arange(BLOCK//8 * w)[None, :]]
+        bits = np.unpackbits(raw, axis=1, bitorder="little").reshape(len(sel), BLOCK, w)
+        vals = np.zeros((len(sel), BLOCK), dtype=np.uint64)
+        for b in range(w):
+            vals |= bits[:, :, b].astype(np.uint64) << np.uint64(b)
+        z[sel] = vals
+
+    # zigzag decode, then two prefix sums undo the linear prediction
+    z = z.ravel()[:n-1]
+    r = (z >> np.uint64(1)) ^ (np.uint64(0) - (z & np.uint64(1)))
+    a = np.empty(n, dtype=np.uint64)
+    a[0] = first
+    a[1:] = first + np.cumsum(np.cumsum(r, dtype=np.uint64), dtype=np.uint64)
+    return a
+
+
+def decode_delta(buf, n, dtype):
+    """Inverse of FloatCodec::encode for one run of n values."""
+    if n == 0:
+        return np.zeros(0, dtype)
+    a = _decode_ints(buf, n)
+
+    # ordered integers back to the bits of the values
+    if dtype == np.float64:
+        sign = np.uint64(1 << 63)
+        return np.where(a & sign, a & ~sign, ~a).view(np.float64)
+    a = a.astype(np.uint32)
+    sign = np.uint32(1 << 31)
+    return np.where(a & sign, a & ~sign, ~a).view(np.float32)
+
+
+def decode_quant(buf, n, dtype):
+    """Inverse of FloatCodec::quantize for one run of n values."""
+    if n == 0:
+        return np.zeros(0, dtype)
+    step = np.frombuffer(buf, dtype=np.float64, count=1)[0]
+    return (_decode_ints(buf[8:], n).view(np.int64) * step).astype(dtype)
+
+
+def read_grid(filename):
+    """Returns the coordinate arrays x, y, each (height+1) x (width+1),
+    from a Domain::toFile or Domain::toFileCompressed file."""
+    with open(filename, "rb") as f:
+        if f.read(8) == b"GRIDFC1\0":
+            width, height, chunk, quantized = (int(v) for v in np.fromfile(f, dtype=np.int32, count=4))
+            n = (width+1) * (height+1)
+            chunks = (n + chunk - 1) // chunk
+            decode = decode_quant if quantized else decode_delta
+            planes = []
+            for _ in range(2):
+                sizes = np.fromfile(f, dtype=np.uint64, count=chunks)
+                parts = [decode(f.read(int(size)), min(chunk, n - c*chunk), np.float64)
+                         for c, size in enumerate(sizes)]
+                values = np.concatenate(parts) if parts else np.zeros(0)
+                planes.append(values.reshape((height+1, width+1)))
+            return planes[0], planes[1]
+        f.seek(0)
+        width, height = np.fromfile(f, dtype=np.int32, count=2)
+    # x, y pairs row-major after the two int32, mapped without copying
+    xy = np.memmap(filename, dtype=np.float64, mode="r", offset=8, shape=(height+1, width+1, 2))
+    return xy[:, :, 0], xy[:, :, 1]
@@ -0,0 +1,44 @@
+#ifndef ASYNCWRITER_HPP
+#define ASYNCWRITER_HPP
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+
+// Runs output jobs in order on one background thread, so computing can go
+// on while earlier results are written. Jobs own snapshots of the data
+// they write. At most depth jobs wait at a time, submit blocks beyond
+// that, which bounds the memory held by snapshots.
+class AsyncWriter {
+
+public:
+	explicit AsyncWriter(size_t depth=2);
+	// Waits for the queued jobs, errors are lost then
+	~AsyncWriter();
+
+	void submit(std::function<void()> job);
+	// Waits until every submitted job is done and rethrows the first
+	// error any of them threw since the last flush
+	void flush();
+
+private:
+	AsyncWriter(const AsyncWriter&);
+	AsyncWriter& operator=(const AsyncWriter&);
+
+	size_t depth;
+	std::deque<std::function<void()> > jobs;
+	bool busy; // a job is running
+	bool stop;
+	std::exception_ptr error;
+	std::mutex lock;
+	std::condition_variable changed;
+	std::thread worker;
+
+	void run();
+};
+
+#endif //ASYNCWRITER_HPP
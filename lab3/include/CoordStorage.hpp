@@ -0,0 +1,124 @@
+#ifndef COORDSTORAGE_HPP
+#define COORDSTORAGE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Allocator that leaves doubles uninitialized on resize, so the pages of
+// the coordinate arrays are first touched by the threads that fill them.
+template <class T>
+struct DefaultInitAllocator : std::allocator<T> {
+	template <class U> struct rebind { typedef DefaultInitAllocator<U> other; };
+	DefaultInitAllocator() = default;
+	template <class U> DefaultInitAllocator(const DefaultInitAllocator<U>&) {}
+	template <class U> void construct(U* p) { ::new ((void*)p) U; }
+	template <class U, class... Args> void construct(U* p, Args&&... args) {
+		::new ((void*)p) U(std::forward<Args>(args)...);
+	}
+};
+
+typedef std::vector<double, DefaultInitAllocator<double> > CoordVector;
+
+// Backing memory of the grid coordinates. Lives on the heap by default,
+// or in a memory-mapped file that other processes can map read-only.
+//
+// Point k (row-major) is placed according to the layout:
+//   PLANAR       all x values, then all y values
+//   INTERLEAVED  x0 y0 x1 y1 ..., the order of the toFile format
+//   TILED        TILE x values, then the same TILE y values, and so on
+//
+// A mapped file is in the toFile format of Domain: int width, int height,
+// then the points as x, y doubles. Mapped storage therefore always has the
+// INTERLEAVED layout.
+class CoordStorage {
+
+public:
+	enum Layout { PLANAR, INTERLEAVED, TILED };
+	// Points per TILED block, one cache line of x then one of y
+	static const size_t TILE = 8;
+	// int width, int height before the coordinates of a mapped file
+	static const size_t HEADER_BYTES = 2*sizeof(int);
+
+	// Offsets of the x and y value of point k among count points
+	template <Layout L> static size_t xoff(size_t k, size_t count);
+	template <Layout L> static size_t yoff(size_t k, size_t count);
+	// Doubles needed to store points in layout
+	static size_t doubles(Layout layout, size_t points);
+
+	CoordStorage();
+	CoordStorage(const CoordStorage& s); // copies always live on the heap
+	CoordStorage(CoordStorage&& s);
+	CoordStorage& operator=(const CoordStorage& s);
+	CoordStorage& operator=(CoordStorage&& s);
+	~CoordStorage();
+
+	// Room for (width+1)*(height+1) points, contents are unspecified
+	void resize(int width, int height);
+	// Rearrange the stored points, mapped storage stays INTERLEAVED
+	void setLayout(Layout layout);
+	Layout layout() const { return lay; }
+
+	// Back the storage by filename. Writable maps create or resize the
+	// file and keep the current contents, rearranged to INTERLEAVED;
+	// read-only maps take the size from the file header.
+	void map(const char* filename, bool writable);
+	// Flush a writable map to its file
+	void sync() const;
+
+	bool mapped() const;
+	const std::string& path() const;
+	// Whether filename is the mapped file, under this or any other path
+	bool maps(const char* filename) const;
+	// Size passed to the last resize, or read from a mapped file header
+	int width() const;
+	int height() const;
+
+	double* data() { return base; }
+	const double* data() const { return base; }
+	size_t size() const { return count; }
+
+	// Coordinate planes, PLANAR layout only
+	const double* x() const;
+	const double* y() const;
+
+	// Single point access in any layout
+	double x(size_t k) const;
+	double y(size_t k) const;
+	void set(size_t k, double x, double y);
+
+private:
+	CoordVector heap;
+	double* base;
+	size_t count;
+	Layout lay;
+
+	int dims[2]; // width, height of the last resize, for the file header
+
+	int fd;
+	void* map_base;
+	size_t map_len;
+	bool writable;
+	std::string filename;
+
+	void unmap();
+	// Resize a writable map; on failure the old map and size are kept
+	void remap(int width, int height);
+	static void* map_writable(int fd, size_t len);
+	void adopt(void* mem, size_t len, size_t points, int width, int height);
+};
+
+template <> inline size_t CoordStorage::xoff<CoordStorage::PLANAR>(size_t k, size_t) { return k; }
+template <> inline size_t CoordStorage::yoff<CoordStorage::PLANAR>(size_t k, size_t count) { return count + k; }
+template <> inline size_t CoordStorage::xoff<CoordStorage::INTERLEAVED>(size_t k, size_t) { return 2*k; }
+template <> inline size_t CoordStorage::yoff<CoordStorage::INTERLEAVED>(size_t k, size_t) { return 2*k + 1; }
+template <> inline size_t CoordStorage::xoff<CoordStorage::TILED>(size_t k, size_t) {
+	return (k / TILE) * 2*TILE + k % TILE;
+}
+template <> inline size_t CoordStorage::yoff<CoordStorage::TILED>(size_t k, size_t) {
+	return (k / TILE) * 2*TILE + TILE + k % TILE;
+}
+
+#endif //COORDSTORAGE_HPP
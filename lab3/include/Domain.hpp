@@ -2,8 +2,13 @@
 #define DOMAIN_HPP
 
 #include "Curvebase.hpp"
+#include "Stretching.hpp"
+#include "CoordStorage.hpp"
+#include "AsyncWriter.hpp"
 #include <cstdio>
 #include <vector>
+#include <memory>
+#include <utility>
 
 
 typedef struct {
@@ -11,24 +16,86 @@ typedef struct {
 	double y;
 } Point;
 
+// Stretched grid line parameters and the boundary curves sampled on them,
+// shared by all stages of grid generation.
+struct GridLines {
+	std::vector<double> eta, xi;
+	std::vector<Point> left, right, bottom, top;
+	Point top0, top1, bottom0, bottom1;
+};
 
 
 class Domain {
 
 public:
 
+	enum Schedule { STATIC, DYNAMIC, GUIDED };
+
 	static bool closedDomain(Curvebase* curves[], int len);
-	// static Domain fromFile(FILE *file);
+	// Read a grid written by toFile or toFileCompressed into layout.
+	// The toFile format is int32 width, int32 height, then the
+	// (height+1)*(width+1) points row-major as x, y doubles, the order of
+	// the INTERLEAVED layout, so that layout is read with one read and
+	// NumPy maps it with np.memmap(filename, np.float64, "r", offset=8,
+	// shape=(height+1, width+1, 2)). No boundary curves, like fromMappedFile.
+	static Domain fromFile(const char* filename,
+		CoordStorage::Layout layout=CoordStorage::INTERLEAVED);
+	// Share a grid file in the toFile format, such as one written through
+	// mapStorage, read-only and without boundary curves, so it can be
+	// inspected but not regenerated. The layout is INTERLEAVED.
+	static Domain fromMappedFile(const char* filename);
 
 	Domain(Curvebase& c1, Curvebase& c2, Curvebase& c3, Curvebase& c4);
 	Domain(const Domain& d);
+	Domain(Domain&& d); // keeps a mapped grid mapped
 	Domain& operator=(Domain& d);
+	Domain& operator=(Domain&& d); // keeps a mapped grid mapped
 
 	bool operator==(Domain& d) const;
 	bool operator!=(Domain& d) const;
 
+	// delta != 0 clusters the eta lines with the tanh law
 	void generate_grid(const int m, const int n, const double delta=0.0);
+	void generate_grid(const int m, const int n, const Stretching& xi, const Stretching& eta);
+	// threads <= 0 uses the OpenMP default, tile is the edge of the 2-D
+	// blocks of nodes handed to each thread.
+	void setParallel(int threads, Schedule schedule=STATIC, int tile=64);
+
+	// Stages of generate_grid, usable on their own to build grids as tasks.
+	// Boundary samples are indexed 0..m+n+2: rows, then columns, then corners.
+	void begin_grid(const int m, const int n, const Stretching& xi, const Stretching& eta,
+		GridLines& lines);
+	int boundary_samples() const;
+	void sample_boundary(GridLines& lines, int k0, int k1) const;
+	void interpolate(const GridLines& lines, int i0, int i1, int j0, int j1);
 	void toFile(const char* filename) const;
+	// Same file, written on the writer's thread from a copy of the grid
+	// taken now. Errors show up at writer.flush().
+	void toFile(const char* filename, AsyncWriter& writer) const;
+	// Compressed grid file, the x and y coordinates each coded with
+	// FloatCodec in runs of CODEC_CHUNK values, lossless for tolerance 0,
+	// otherwise every coordinate within tolerance. Native byte order:
+	//   char[8] magic "GRIDFC1", int32 width, height, values per run,
+	//   int32 1 if quantized, then for x and for y: uint64 stored size
+	//   of every run, the runs
+	void toFileCompressed(const char* filename, const double tolerance=0.0) const;
+	static const int CODEC_CHUNK = 1 << 16;
+	// Keep the coordinates in a memory-mapped file instead of on the heap.
+	// The file is in the toFile format, so the coordinates are INTERLEAVED
+	// while mapped. Grids are generated straight into the page cache, and
+	// toFile on the same file, under any path, only flushes the map.
+	void mapStorage(const char* filename);
+	// Placement of the coordinates in memory, see CoordStorage. PLANAR
+	// suits kernels that read one coordinate at a time (metric terms),
+	// INTERLEAVED makes toFile a single write, TILED keeps the x and y of
+	// a point in neighbouring cache lines.
+	void setLayout(CoordStorage::Layout layout);
+	CoordStorage::Layout layout() const;
+	// Generate a grid straight into filename, in the toFile format, without
+	// keeping it in memory: only block_rows rows (0 picks about 1M nodes)
+	// are held at a time, and writing one block overlaps computing the next.
+	void generate_to_file(const char* filename, const int m, const int n,
+		const Stretching& xi, const Stretching& eta, int block_rows=0) const;
 
 	Point getPoint(int row, int col) const;
 	double getX(int row, int col) const;
@@ -36,6 +103,10 @@ public:
 
 	std::vector<double> getX() const;
 	std::vector<double> getY() const;
+	// Coordinate arrays without copying, row-major (ysize()+1) x (xsize()+1).
+	// PLANAR layout only, getX/getY gather them in any layout.
+	const double* x_data() const;
+	const double* y_data() const;
 
 	int xsize() const;
 	int ysize() const;
@@ -43,17 +114,29 @@ public:
 	bool grid_valid();
 	
 private:
+	Domain(); // no boundary, for fromMappedFile and fromFile
+	void read_compressed(FILE* file);
+
 	Curvebase *boundary[4];
 
-	std::vector<double> x_coor;
-	std::vector<double> y_coor;
+	CoordStorage coords;
 
 	int width; // n
 	int height; // m
 
+	int threads;
+	Schedule schedule;
+	int tile;
+
+	static void prepare_lines(const int m, const int n, const Stretching& xi,
+		const Stretching& eta, GridLines& lines);
+	void sample_all(GridLines& lines, int nthreads) const;
+	template <CoordStorage::Layout L>
+	void interpolate_into(const GridLines& lines, int i0, int i1, int j0, int j1,
+		double* base, size_t count, int first_row) const;
+
 	static double phi1(const double s); // from 1 to 0
 	static double phi2(const double s); // from 0 to 1
-	static double stretch(const double sigma, const double delta);
 	void setPoint(int row, int col, double x, double y);
 	void setPoint(int row, int col, Point p);
 };
@@ -0,0 +1,51 @@
+#ifndef FLOATCODEC_HPP
+#define FLOATCODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless predictive coding of float and double arrays, in the style of
+// FPZIP. The values are mapped to integers in the same order, every value
+// is predicted by linear extrapolation from the two before it, and only
+// the residuals are stored. Residuals of smooth data have few significant
+// bits, they are zigzag coded and bit packed BLOCK at a time with the
+// width of the largest one. One coded run:
+//
+//   uint64   first value as ordered integer
+//   uint8    bit width of each block of residuals 1..n-1
+//   ...      the blocks, BLOCK*width bits each, least significant first,
+//            the last one cut to whole bytes after its last residual
+//
+// Decoding is a zigzag decode and two prefix sums, so it vectorizes
+// (gfield.py does it in NumPy).
+//
+// quantize is the lossy variant for plotting: values are rounded to the
+// nearest multiple q*step of a step a little below 2*tolerance, so each
+// one changes by at most tolerance, and the integers q go through the
+// same prediction and packing. The run starts with step as a double.
+// Smooth fields need only a few bits per value then.
+class FloatCodec {
+
+public:
+	static const int BLOCK = 32;
+
+	template <class T>
+	static void encode(const T* values, size_t n, std::vector<unsigned char>& out);
+	template <class T>
+	static void decode(const unsigned char* in, size_t size, T* out, size_t n);
+
+	template <class T>
+	static void quantize(const T* values, size_t n, double tolerance,
+		std::vector<unsigned char>& out);
+	template <class T>
+	static void dequantize(const unsigned char* in, size_t size, T* out, size_t n);
+
+	// values in runs of chunk values, all runs coded in parallel, with
+	// quantize if tolerance > 0
+	template <class T>
+	static void encode(const T* values, size_t n, size_t chunk, double tolerance,
+		std::vector<std::vector<unsigned char> >& out);
+};
+
+#endif //FLOATCODEC_HPP
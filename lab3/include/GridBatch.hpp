@@ -0,0 +1,58 @@
+#ifndef GRIDBATCH_HPP
+#define GRIDBATCH_HPP
+
+#include "Domain.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <exception>
+
+// Timing of one task of a batch run
+struct TaskTiming {
+	int job;
+	const char* stage; // "sample", "interpolate" or "write"
+	int thread;
+	double start; // seconds since GridBatch::run started
+	double seconds;
+};
+
+// Generates many grids in one go. Every grid is split into boundary
+// sampling, interpolation and output tasks on a shared OpenMP task pool,
+// so threads that finish a small grid pick up chunks of the larger ones
+// instead of idling.
+class GridBatch {
+
+public:
+	explicit GridBatch(int threads=0);
+
+	// Queue a grid on the boundary of shape. Empty filename keeps the
+	// grid in memory only. Returns the job index.
+	int add(const Domain& shape, int m, int n, double delta=0.0,
+		const std::string& filename="");
+	int add(const Domain& shape, int m, int n, const Stretching& xi,
+		const Stretching& eta, const std::string& filename="");
+
+	void run();
+
+	const Domain& result(int job) const;
+	const std::vector<TaskTiming>& timings() const;
+	void printTimings(FILE* out=stdout) const;
+
+private:
+	struct Job {
+		Domain domain;
+		int m, n;
+		Stretching xi, eta;
+		std::string filename;
+		GridLines lines;
+		std::exception_ptr error;
+	};
+
+	std::vector<Job> jobs;
+	std::vector<TaskTiming> times;
+	int threads;
+
+	void record(int job, const char* stage, double start, double t0);
+};
+
+#endif //GRIDBATCH_HPP
@@ -0,0 +1,51 @@
+#ifndef GRIDTILES_HPP
+#define GRIDTILES_HPP
+
+// Block [i0, i1) x [j0, j1) of a row-major grid, and the same block
+// grown by the halo on every side that is not the grid boundary.
+struct Tile {
+	int i0, i1, j0, j1;
+	int hi0, hi1, hj0, hj1;
+
+	int rows() const { return i1 - i0; }
+	int cols() const { return j1 - j0; }
+	int halo_rows() const { return hi1 - hi0; }
+	int halo_cols() const { return hj1 - hj0; }
+};
+
+// Splits a rows x cols grid into tile x tile blocks, row of tiles by row
+// of tiles. Operator pipelines that need neighbouring values of an
+// intermediate result compute it on the halo block first, so every
+// tile can be finished while its working set is in cache.
+class GridTiles {
+
+public:
+	class iterator {
+	public:
+		iterator(const GridTiles& tiles, int k) : tiles(tiles), k(k) {}
+		Tile operator*() const { return tiles[k]; }
+		iterator& operator++() { ++k; return *this; }
+		bool operator!=(const iterator& it) const { return k != it.k; }
+	private:
+		const GridTiles& tiles;
+		int k;
+	};
+
+	GridTiles(int rows, int cols, int tile, int halo=0);
+
+	int size() const;
+	Tile operator[](int k) const;
+	iterator begin() const { return iterator(*this, 0); }
+	iterator end() const { return iterator(*this, this->size()); }
+
+	// Largest halo block, for sizing per-thread buffers
+	int max_halo_rows() const;
+	int max_halo_cols() const;
+
+private:
+	int rows, cols;
+	int tile, halo;
+	int tiles_i, tiles_j;
+};
+
+#endif //GRIDTILES_HPP
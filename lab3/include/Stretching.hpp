@@ -0,0 +1,31 @@
+#ifndef STRETCHING_HPP
+#define STRETCHING_HPP
+
+// One-dimensional grid stretching, a monotone map of [0, 1] onto itself
+// that clusters grid lines towards sigma = 0 (or both ends for TWO_SIDED).
+// The map is tabulated once per grid line, so its cost is O(m + n).
+class Stretching {
+
+public:
+	enum Law {
+		UNIFORM,   // sigma
+		TANH,      // 1 + tanh(delta*(sigma - 1))/tanh(delta)
+		SINH,      // sinh(delta*sigma)/sinh(delta)
+		GEOMETRIC, // (exp(delta*sigma) - 1)/(exp(delta) - 1), constant spacing ratio
+		ROBERTS,   // Roberts' boundary layer map, delta = beta > 1, smaller is stronger
+		TWO_SIDED  // (1 + tanh(delta*(sigma - 1/2))/tanh(delta/2))/2
+	};
+
+	Stretching(Law law=UNIFORM, double delta=0.0);
+
+	double operator()(const double sigma) const;
+
+	Law getLaw() const;
+	double getDelta() const;
+
+private:
+	Law law;
+	double delta;
+};
+
+#endif //STRETCHING_HPP
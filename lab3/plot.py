@@ -1,6 +1,7 @@
 import matplotlib.pyplot as plt
 import numpy as np
 import sys
+import gridfile
 
 filename = "myfile.bin"
 
@@ -8,24 +9,13 @@ if(len(sys.argv) > 1):
 	filename = sys.argv[1]
 
 
-file = open(filename, "rb")
-
-width = np.fromfile(file, dtype=np.int32, count=1)[0]
-height = np.fromfile(file, dtype=np.int32, count=1)[0]
-
-x = []
-y = []
+# Domain::toFile files are mapped without copying, toFileCompressed
+# files decoded
+x, y = gridfile.read_grid(filename)
+height, width = x.shape[0] - 1, x.shape[1] - 1
 
 print(width, height)
 
-for i in range((width+1)*(height+1)):
-	x.append(np.fromfile(file, dtype=np.float64, count=1)[0])
-	y.append(np.fromfile(file, dtype=np.float64, count=1)[0])
-
-# plt.scatter(x, y, 'b');
-x = np.array(x).reshape((height+1, width+1))
-y = np.array(y).reshape((height+1, width+1))
-
 for i in range(height+1):
 	plt.plot(x[i,:], y[i,:], 'r-')
 
@@ -0,0 +1,65 @@
+#include "AsyncWriter.hpp"
+#include <stdexcept>
+
+AsyncWriter::AsyncWriter(size_t depth)
+: depth(depth), busy(false), stop(false), error(nullptr) {
+	if (depth == 0) throw std::invalid_argument("Queue depth must be positive");
+	this->worker = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+	try {
+		this->flush();
+	} catch (...) {
+	}
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->stop = true;
+	}
+	this->changed.notify_all();
+	this->worker.join();
+}
+
+void AsyncWriter::submit(std::function<void()> job) {
+	std::unique_lock<std::mutex> guard(this->lock);
+	this->changed.wait(guard, [this] { return this->jobs.size() < this->depth; });
+	this->jobs.push_back(std::move(job));
+	this->changed.notify_all();
+}
+
+void AsyncWriter::flush() {
+	std::unique_lock<std::mutex> guard(this->lock);
+	this->changed.wait(guard, [this] { return this->jobs.empty() && !this->busy; });
+	if (this->error) {
+		std::exception_ptr e = this->error;
+		this->error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+void AsyncWriter::run() {
+	std::unique_lock<std::mutex> guard(this->lock);
+	while (true) {
+		this->changed.wait(guard, [this] { return this->stop || !this->jobs.empty(); });
+		if (this->jobs.empty())
+			return; // stop, and nothing left to write
+
+		std::function<void()> job = std::move(this->jobs.front());
+		this->jobs.pop_front();
+		this->busy = true;
+		this->changed.notify_all(); // room in the queue
+
+		guard.unlock();
+		try {
+			job();
+		} catch (...) {
+			guard.lock();
+			if (!this->error) this->error = std::current_exception();
+			guard.unlock();
+		}
+		job = nullptr; // free the snapshot before taking the next job
+		guard.lock();
+		this->busy = false;
+		this->changed.notify_all();
+	}
+}
@@ -0,0 +1,333 @@
+#include "CoordStorage.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Copy count points from src in layout from into dst in layout to
+template <CoordStorage::Layout From, CoordStorage::Layout To>
+static void convert(const double* src, double* dst, size_t count) {
+	#pragma omp parallel for schedule(static)
+	for (size_t k = 0; k < count; ++k) {
+		dst[CoordStorage::xoff<To>(k, count)] = src[CoordStorage::xoff<From>(k, count)];
+		dst[CoordStorage::yoff<To>(k, count)] = src[CoordStorage::yoff<From>(k, count)];
+	}
+}
+
+template <CoordStorage::Layout From>
+static void convert(const double* src, double* dst, size_t count, CoordStorage::Layout to) {
+	switch (to) {
+	case CoordStorage::PLANAR: convert<From, CoordStorage::PLANAR>(src, dst, count); break;
+	case CoordStorage::INTERLEAVED: convert<From, CoordStorage::INTERLEAVED>(src, dst, count); break;
+	case CoordStorage::TILED: convert<From, CoordStorage::TILED>(src, dst, count); break;
+	}
+}
+
+size_t CoordStorage::doubles(Layout layout, size_t points) {
+	if (layout == TILED)
+		return 2*TILE*((points + TILE - 1) / TILE);
+	return 2*points;
+}
+
+CoordStorage::CoordStorage()
+: base(nullptr), count(0), lay(PLANAR), dims{0, 0},
+  fd(-1), map_base(nullptr), map_len(0), writable(false) {}
+
+CoordStorage::CoordStorage(const CoordStorage& s) : CoordStorage() {
+	*this = s;
+}
+
+CoordStorage::CoordStorage(CoordStorage&& s)
+: heap(std::move(s.heap)), base(s.base), count(s.count), lay(s.lay), dims{s.dims[0], s.dims[1]},
+  fd(s.fd), map_base(s.map_base), map_len(s.map_len), writable(s.writable),
+  filename(std::move(s.filename)) {
+	s.fd = -1;
+	s.map_base = nullptr;
+	s.map_len = 0;
+	s.base = nullptr;
+	s.count = 0;
+}
+
+CoordStorage& CoordStorage::operator=(const CoordStorage& s) {
+	if (this == &s)
+		return *this;
+
+	CoordVector copy(s.base, s.base + CoordStorage::doubles(s.lay, s.count));
+	this->unmap();
+	this->heap.swap(copy);
+	this->base = this->heap.data();
+	this->count = s.count;
+	this->lay = s.lay;
+	this->dims[0] = s.dims[0];
+	this->dims[1] = s.dims[1];
+	return *this;
+}
+
+CoordStorage& CoordStorage::operator=(CoordStorage&& s) {
+	if (this == &s)
+		return *this;
+
+	this->unmap();
+	this->heap = std::move(s.heap);
+	this->base = s.base;
+	this->count = s.count;
+	this->lay = s.lay;
+	this->dims[0] = s.dims[0];
+	this->dims[1] = s.dims[1];
+	this->fd = s.fd;
+	this->map_base = s.map_base;
+	this->map_len = s.map_len;
+	this->writable = s.writable;
+	this->filename = std::move(s.filename);
+
+	s.fd = -1;
+	s.map_base = nullptr;
+	s.map_len = 0;
+	s.base = nullptr;
+	s.count = 0;
+	return *this;
+}
+
+CoordStorage::~CoordStorage() {
+	this->unmap();
+}
+
+void CoordStorage::resize(int width, int height) {
+	const size_t points = (size_t)(width + 1) * (height + 1);
+
+	if (this->mapped() && !this->writable)
+		throw std::invalid_argument("Grid is mapped read-only");
+	if (this->mapped()) {
+		this->remap(width, height);
+		return;
+	}
+
+	this->heap.resize(CoordStorage::doubles(this->lay, points));
+	this->base = this->heap.data();
+	this->count = points;
+	this->dims[0] = width;
+	this->dims[1] = height;
+}
+
+void CoordStorage::setLayout(Layout layout) {
+	if (layout < PLANAR || layout > TILED)
+		throw std::invalid_argument("Unknown coordinate layout");
+	if (layout == this->lay)
+		return;
+	if (this->mapped())
+		throw std::invalid_argument("A mapped grid keeps the INTERLEAVED layout of its file");
+
+	CoordVector tmp(CoordStorage::doubles(layout, this->count));
+	switch (this->lay) {
+	case PLANAR: convert<PLANAR>(this->base, tmp.data(), this->count, layout); break;
+	case INTERLEAVED: convert<INTERLEAVED>(this->base, tmp.data(), this->count, layout); break;
+	case TILED: convert<TILED>(this->base, tmp.data(), this->count, layout); break;
+	}
+
+	this->lay = layout;
+	this->heap.swap(tmp);
+	this->base = this->heap.data();
+}
+
+void CoordStorage::map(const char* filename, bool writable) {
+	int fd = open(filename, writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (fd < 0)
+		throw std::invalid_argument("Could not open grid map file");
+
+	if (!writable) {
+		struct stat st;
+		int fields[2];
+		if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_BYTES
+			|| pread(fd, fields, HEADER_BYTES, 0) != (ssize_t)HEADER_BYTES
+			|| fields[0] < 0 || fields[1] < 0) {
+			close(fd);
+			throw std::invalid_argument("Not a grid file");
+		}
+		const size_t points = (size_t)(fields[0] + 1) * (fields[1] + 1);
+		if ((size_t)st.st_size != HEADER_BYTES + CoordStorage::doubles(INTERLEAVED, points)*sizeof(double)) {
+			close(fd);
+			throw std::invalid_argument("Not a grid file");
+		}
+
+		void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (mem == MAP_FAILED) {
+			close(fd);
+			throw std::invalid_argument("Could not map grid file");
+		}
+		this->unmap();
+		this->heap = CoordVector();
+		this->fd = fd;
+		this->map_base = mem;
+		this->map_len = st.st_size;
+		this->writable = false;
+		this->filename = filename;
+		this->count = points;
+		this->lay = INTERLEAVED;
+		this->dims[0] = fields[0];
+		this->dims[1] = fields[1];
+		this->base = (double*)((char*)mem + HEADER_BYTES);
+		return;
+	}
+
+	// Writable: copy the current contents into the new map in file order,
+	// the old storage is only let go once that succeeded
+	CoordVector old(CoordStorage::doubles(INTERLEAVED, this->count));
+	switch (this->lay) {
+	case PLANAR: convert<PLANAR>(this->base, old.data(), this->count, INTERLEAVED); break;
+	case INTERLEAVED: convert<INTERLEAVED>(this->base, old.data(), this->count, INTERLEAVED); break;
+	case TILED: convert<TILED>(this->base, old.data(), this->count, INTERLEAVED); break;
+	}
+	const size_t len = HEADER_BYTES + old.size()*sizeof(double);
+	void* mem;
+	try {
+		mem = map_writable(fd, len);
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+	if (!old.empty())
+		memcpy((char*)mem + HEADER_BYTES, old.data(), old.size()*sizeof(double));
+
+	const size_t points = this->count;
+	this->unmap();
+	this->heap = CoordVector();
+	this->fd = fd;
+	this->writable = true;
+	this->filename = filename;
+	this->lay = INTERLEAVED;
+	this->adopt(mem, len, points, this->dims[0], this->dims[1]);
+}
+
+// Maps the first len bytes of fd for writing, growing the file first if
+// it is shorter. The file is shrunk again if the map fails, an existing
+// map of it stays valid either way.
+void* CoordStorage::map_writable(int fd, size_t len) {
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		throw std::runtime_error("Could not resize grid map file");
+	const bool grow = (size_t)st.st_size < len;
+	if (grow && ftruncate(fd, len) != 0)
+		throw std::runtime_error("Could not resize grid map file");
+
+	void* mem = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		if (grow) {
+			const int rc = ftruncate(fd, st.st_size);
+			(void)rc; // at worst the file stays longer, nothing maps it there
+		}
+		throw std::runtime_error("Could not map grid file");
+	}
+	return mem;
+}
+
+// Replace the current map of fd by mem, then cut the file to len
+void CoordStorage::adopt(void* mem, size_t len, size_t points, int width, int height) {
+	if (this->map_base != nullptr)
+		munmap(this->map_base, this->map_len);
+	this->map_base = mem;
+	this->map_len = len;
+	this->count = points;
+	this->dims[0] = width;
+	this->dims[1] = height;
+	this->base = (double*)((char*)mem + HEADER_BYTES);
+
+	// The toFile header, the coordinates follow in file order
+	memcpy(mem, this->dims, HEADER_BYTES);
+	if (ftruncate(this->fd, len) != 0)
+		throw std::runtime_error("Could not resize grid map file");
+}
+
+void CoordStorage::remap(int width, int height) {
+	const size_t points = (size_t)(width + 1) * (height + 1);
+	const size_t len = HEADER_BYTES + CoordStorage::doubles(this->lay, points)*sizeof(double);
+	this->adopt(map_writable(this->fd, len), len, points, width, height);
+}
+
+void CoordStorage::sync() const {
+	if (this->mapped() && this->writable)
+		msync(this->map_base, this->map_len, MS_SYNC);
+}
+
+bool CoordStorage::mapped() const {
+	return this->fd >= 0;
+}
+
+const std::string& CoordStorage::path() const {
+	return this->filename;
+}
+
+bool CoordStorage::maps(const char* filename) const {
+	struct stat mine, other;
+	return this->mapped() && fstat(this->fd, &mine) == 0 && stat(filename, &other) == 0
+		&& mine.st_dev == other.st_dev && mine.st_ino == other.st_ino;
+}
+
+int CoordStorage::width() const {
+	return this->dims[0];
+}
+
+int CoordStorage::height() const {
+	return this->dims[1];
+}
+
+const double* CoordStorage::x() const {
+	if (this->lay != PLANAR)
+		throw std::logic_error("Coordinate planes need the PLANAR layout");
+	return this->base;
+}
+
+const double* CoordStorage::y() const {
+	if (this->lay != PLANAR)
+		throw std::logic_error("Coordinate planes need the PLANAR layout");
+	return this->base + this->count;
+}
+
+double CoordStorage::x(size_t k) const {
+	switch (this->lay) {
+	case INTERLEAVED: return this->base[xoff<INTERLEAVED>(k, this->count)];
+	case TILED: return this->base[xoff<TILED>(k, this->count)];
+	default: return this->base[xoff<PLANAR>(k, this->count)];
+	}
+}
+
+double CoordStorage::y(size_t k) const {
+	switch (this->lay) {
+	case INTERLEAVED: return this->base[yoff<INTERLEAVED>(k, this->count)];
+	case TILED: return this->base[yoff<TILED>(k, this->count)];
+	default: return this->base[yoff<PLANAR>(k, this->count)];
+	}
+}
+
+void CoordStorage::set(size_t k, double x, double y) {
+	switch (this->lay) {
+	case INTERLEAVED:
+		this->base[xoff<INTERLEAVED>(k, this->count)] = x;
+		this->base[yoff<INTERLEAVED>(k, this->count)] = y;
+		break;
+	case TILED:
+		this->base[xoff<TILED>(k, this->count)] = x;
+		this->base[yoff<TILED>(k, this->count)] = y;
+		break;
+	default:
+		this->base[xoff<PLANAR>(k, this->count)] = x;
+		this->base[yoff<PLANAR>(k, this->count)] = y;
+	}
+}
+
+void CoordStorage::unmap() {
+	if (!this->mapped())
+		return;
+
+	if (this->map_base != nullptr)
+		munmap(this->map_base, this->map_len);
+	close(this->fd);
+	this->fd = -1;
+	this->map_base = nullptr;
+	this->map_len = 0;
+	this->writable = false;
+	this->filename.clear();
+	this->base = nullptr;
+	this->count = 0;
+}
@@ -48,7 +48,11 @@ double Curvebase::p_from_s(double s) const {
     ++numIt;
     diff = abs(p - pp);
   } 
-  if (numIt >= maxiter) std::cerr << "TOO MANY ITERATIONS, NO CONVERGENCE: double Curvebase::p_from_s(double s)" << std::endl;
+  if (numIt >= maxiter) {
+    // may be reached from several grid generation threads at once
+    #pragma omp critical(curvebase_diag)
+    std::cerr << "TOO MANY ITERATIONS, NO CONVERGENCE: double Curvebase::p_from_s(double s)" << std::endl;
+  }
 
   return pp;
 }
@@ -63,6 +67,7 @@ double Curvebase::y(double s) const {
 
 void Curvebase::validate_p(double p) const {
   if (p < this->_pmin || p > this->_pmax) {
+    #pragma omp critical(curvebase_diag)
     std::cerr << "(p, pmin, pmax) = (" << p << ", " << _pmin << ", " << _pmax << ")" << std::endl;
     throw std::invalid_argument("p must be within [pmin, pmax]");
   }
@@ -1,7 +1,18 @@
 #include "Domain.hpp"
+#include "GridTiles.hpp"
+#include "FloatCodec.hpp"
 #include <stdexcept>
 #include <cmath>
+#include <algorithm>
 #include <cstdio>
+#include <exception>
+#include <future>
+#include <string>
+#include <cstring>
+#include <omp.h>
+
+static const char COMPRESSED_MAGIC[8] = "GRIDFC1";
+
 // #include <iostream>
 bool Domain::closedDomain(Curvebase* curves[], int len){
 
@@ -33,20 +44,152 @@ Domain::Domain(Curvebase& c1, Curvebase& c2, Curvebase& c3, Curvebase& c4){
 	this->width = 0;
 	this->height = 0;
 
-	this->x_coor = std::vector<double>((this->width+1)*(this->height+1));
-	this->y_coor = std::vector<double>((this->width+1)*(this->height+1));
+	this->threads = 0;
+	this->schedule = STATIC;
+	this->tile = 64;
+
+	this->coords.resize(this->width, this->height);
+
+}
+
+Domain::Domain() : width(0), height(0), threads(0), schedule(STATIC), tile(64) {
+	for (int i = 0; i < 4; ++i)
+		this->boundary[i] = nullptr;
+}
+
+Domain Domain::fromMappedFile(const char* filename) {
+	Domain d;
+	d.coords.map(filename, false);
+	d.width = d.coords.width();
+	d.height = d.coords.height();
+	return d;
+}
+
+Domain Domain::fromFile(const char* filename, CoordStorage::Layout layout) {
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL)
+		throw std::invalid_argument("Could not open grid file for reading");
+
+	Domain d;
+	try {
+		char magic[8];
+		if (fread(magic, 1, sizeof(magic), file) != sizeof(magic))
+			throw std::runtime_error("Grid file is truncated");
+
+		if (memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) == 0) {
+			d.read_compressed(file);
+		} else {
+			int dims[2];
+			memcpy(dims, magic, sizeof(dims));
+			fseek(file, 0, SEEK_END);
+			const long bytes = ftell(file);
+			fseek(file, sizeof(dims), SEEK_SET);
+			if (dims[0] < 0 || dims[1] < 0 || bytes != (long)(sizeof(dims)
+				+ 2*sizeof(double)*(dims[0] + 1)*(size_t)(dims[1] + 1)))
+				throw std::runtime_error("Not a grid file");
+
+			// File order is the INTERLEAVED layout, one read fills it
+			d.coords.setLayout(CoordStorage::INTERLEAVED);
+			d.coords.resize(dims[0], dims[1]);
+			d.width = dims[0];
+			d.height = dims[1];
+			const size_t n = 2*d.coords.size();
+			if (fread(d.coords.data(), sizeof(double), n, file) != n)
+				throw std::runtime_error("Grid file is truncated");
+		}
+	} catch (...) {
+		fclose(file);
+		throw;
+	}
+	fclose(file);
 
+	d.coords.setLayout(layout);
+	return d;
+}
+
+// The rest of a toFileCompressed file after the magic, into PLANAR storage
+void Domain::read_compressed(FILE* file) {
+	int head[4];
+	if (fread(head, sizeof(int), 4, file) != 4)
+		throw std::runtime_error("Grid file is truncated");
+	if (head[0] < 0 || head[1] < 0 || head[2] <= 0)
+		throw std::runtime_error("Not a grid file");
+
+	this->coords.setLayout(CoordStorage::PLANAR);
+	this->coords.resize(head[0], head[1]);
+	this->width = head[0];
+	this->height = head[1];
+	const size_t count = this->coords.size();
+	const size_t chunk = head[2];
+	const size_t runs = (count + chunk - 1) / chunk;
+
+	for (int p = 0; p < 2; ++p) {
+		std::vector<uint64_t> sizes(runs);
+		if (fread(sizes.data(), sizeof(uint64_t), runs, file) != runs)
+			throw std::runtime_error("Grid file is truncated");
+		std::vector<size_t> offsets(runs + 1, 0);
+		for (size_t c = 0; c < runs; ++c)
+			offsets[c + 1] = offsets[c] + sizes[c];
+		std::vector<unsigned char> coded(offsets[runs]);
+		if (fread(coded.data(), 1, coded.size(), file) != coded.size())
+			throw std::runtime_error("Grid file is truncated");
+
+		// Exceptions are kept until after the loop since they may not
+		// leave the OpenMP region.
+		double* plane = this->coords.data() + p*count;
+		std::exception_ptr error = nullptr;
+		#pragma omp parallel for schedule(dynamic)
+		for (size_t c = 0; c < runs; ++c) {
+			const size_t len = std::min(chunk, count - c*chunk);
+			try {
+				if (head[3])
+					FloatCodec::dequantize(coded.data() + offsets[c], sizes[c], plane + c*chunk, len);
+				else
+					FloatCodec::decode(coded.data() + offsets[c], sizes[c], plane + c*chunk, len);
+			} catch (...) {
+				#pragma omp critical(domain_read_error)
+				if (!error) error = std::current_exception();
+			}
+		}
+		if (error) std::rethrow_exception(error);
+	}
+}
+
+void Domain::mapStorage(const char* filename) {
+	this->coords.map(filename, true);
+}
+
+void Domain::setLayout(CoordStorage::Layout layout) {
+	this->coords.setLayout(layout);
+}
+
+CoordStorage::Layout Domain::layout() const {
+	return this->coords.layout();
 }
 
 Domain::Domain(const Domain& d) :
-	width(d.width), height(d.height){
+	width(d.width), height(d.height),
+	threads(d.threads), schedule(d.schedule), tile(d.tile){
+
+	for (int i = 0; i < 4; ++i)
+		this->boundary[i] = d.boundary[i];
 
 	if (d.width == 0 || d.height == 0){
 		return;
 	}
 
-	this->x_coor = d.x_coor;
-	this->y_coor = d.y_coor;
+	this->coords = d.coords;
+}
+
+Domain::Domain(Domain&& d) :
+	coords(std::move(d.coords)),
+	width(d.width), height(d.height),
+	threads(d.threads), schedule(d.schedule), tile(d.tile){
+
+	for (int i = 0; i < 4; ++i)
+		this->boundary[i] = d.boundary[i];
+	d.width = 0;
+	d.height = 0;
 }
 	
 Domain& Domain::operator=(Domain& d){
@@ -55,13 +198,33 @@ Domain& Domain::operator=(Domain& d){
 
 	this->width = d.width;
 	this->height = d.height;
-	this->x_coor = d.x_coor;
-	this->y_coor = d.y_coor;
+	this->threads = d.threads;
+	this->schedule = d.schedule;
+	this->tile = d.tile;
+	this->coords = d.coords;
 
 	return *this;
 
 }
 
+Domain& Domain::operator=(Domain&& d){
+	if (this == &d)
+		return *this;
+
+	for (int i = 0; i < 4; ++i)
+		this->boundary[i] = d.boundary[i];
+	this->width = d.width;
+	this->height = d.height;
+	this->threads = d.threads;
+	this->schedule = d.schedule;
+	this->tile = d.tile;
+	this->coords = std::move(d.coords);
+	d.width = 0;
+	d.height = 0;
+
+	return *this;
+}
+
 bool Domain::operator==(Domain& d) const {
 	if (this == &d)
 		return true;
@@ -73,14 +236,12 @@ bool Domain::operator==(Domain& d) const {
 	if (!(width == d.width && height == d.height)) 
 		return false;
 
-	std::vector<double> x_coor_d = d.getX();
 	for (int j = 0; j < width; ++j) {
-		if (x_coor[j] != x_coor_d[j]) 
+		if (coords.x(j) != d.coords.x(j)) 
 			return false;
 	}
-	std::vector<double> y_coor_d = d.getY();
 	for (int i = 0; i < height; ++i) {
-		if (y_coor[i] != y_coor_d[i]) 
+		if (coords.y(i) != d.coords.y(i)) 
 			return false;
 	}
 	return true;
@@ -90,70 +251,372 @@ bool Domain::operator!=(Domain& d) const {
 	return !(*this == d);
 }
 
+// Writes the count points stored in layout L at base as interleaved
+// (x, y) pairs, the toFile format, going through buf in bounded chunks
+// instead of one fwrite per value.
+template <CoordStorage::Layout L>
+static void write_interleaved(FILE* file, const double* base, size_t count,
+	std::vector<double>& buf) {
+	const size_t chunk = buf.size() / 2;
+	for (size_t k0 = 0; k0 < count; k0 += chunk) {
+		const size_t len = std::min(chunk, count - k0);
+		for (size_t k = 0; k < len; ++k) {
+			buf[2*k] = base[CoordStorage::xoff<L>(k0 + k, count)];
+			buf[2*k + 1] = base[CoordStorage::yoff<L>(k0 + k, count)];
+		}
+		if (fwrite(buf.data(), sizeof(double), 2*len, file) != 2*len)
+			throw std::runtime_error("Could not write grid file");
+	}
+}
+
+// Already in file order
+template <>
+void write_interleaved<CoordStorage::INTERLEAVED>(FILE* file, const double* base, size_t count,
+	std::vector<double>&) {
+	if (fwrite(base, sizeof(double), 2*count, file) != 2*count)
+		throw std::runtime_error("Could not write grid file");
+}
+
 void Domain::toFile(const char* filename) const{
 
+	// A mapped grid already is in its file
+	if (this->coords.maps(filename)) {
+		this->coords.sync();
+		return;
+	}
+
 	FILE *file;
 	file = fopen(filename, "wb");
+	if (file == NULL)
+		throw std::invalid_argument("Could not open grid file for writing");
 
 	fwrite(&this->width, sizeof(int), 1, file);
 	fwrite(&this->height, sizeof(int), 1, file);
-	for (int i = 0; i < (this->width+1)*(this->height+1); ++i){
-		fwrite(&this->x_coor[i], sizeof(double), 1, file);
-		fwrite(&this->y_coor[i], sizeof(double), 1, file);
+
+	std::vector<double> buf(1 << 16);
+	const double* base = this->coords.data();
+	const size_t count = this->coords.size();
+	try {
+		switch (this->coords.layout()) {
+		case CoordStorage::PLANAR: write_interleaved<CoordStorage::PLANAR>(file, base, count, buf); break;
+		case CoordStorage::INTERLEAVED: write_interleaved<CoordStorage::INTERLEAVED>(file, base, count, buf); break;
+		case CoordStorage::TILED: write_interleaved<CoordStorage::TILED>(file, base, count, buf); break;
+		}
+	} catch (...) {
+		fclose(file);
+		throw;
 	}
 
 	fclose(file);
 }
 
-void Domain::generate_grid(const int m, const int n, const double delta) {
+void Domain::toFileCompressed(const char* filename, const double tolerance) const {
+
+	std::vector<double> xs, ys;
+	const double* planes[2];
+	if (this->coords.layout() == CoordStorage::PLANAR) {
+		planes[0] = this->coords.x();
+		planes[1] = this->coords.y();
+	} else {
+		xs = this->getX();
+		ys = this->getY();
+		planes[0] = xs.data();
+		planes[1] = ys.data();
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+		throw std::invalid_argument("Could not open grid file for writing");
+
+	const int head[4] = {this->width, this->height, CODEC_CHUNK, tolerance > 0};
+	bool ok = fwrite(COMPRESSED_MAGIC, 1, sizeof(COMPRESSED_MAGIC), file) == sizeof(COMPRESSED_MAGIC)
+		&& fwrite(head, sizeof(int), 4, file) == 4;
+
+	std::vector<std::vector<unsigned char> > runs;
+	for (int p = 0; ok && p < 2; ++p) {
+		try {
+			FloatCodec::encode(planes[p], this->coords.size(), CODEC_CHUNK, tolerance, runs);
+		} catch (...) {
+			fclose(file);
+			throw;
+		}
+		std::vector<uint64_t> sizes(runs.size());
+		for (size_t c = 0; c < runs.size(); ++c)
+			sizes[c] = runs[c].size();
+		ok = fwrite(sizes.data(), sizeof(uint64_t), sizes.size(), file) == sizes.size();
+		for (size_t c = 0; ok && c < runs.size(); ++c)
+			ok = fwrite(runs[c].data(), 1, runs[c].size(), file) == runs[c].size();
+	}
+
+	fclose(file);
+	if (!ok)
+		throw std::runtime_error("Could not write grid file");
+}
+
+void Domain::toFile(const char* filename, AsyncWriter& writer) const {
+	if (this->coords.maps(filename)) {
+		this->coords.sync();
+		return;
+	}
+
+	// Only the coordinates are needed, not the boundary curves
+	std::shared_ptr<Domain> snapshot(new Domain());
+	snapshot->coords = this->coords;
+	snapshot->width = this->width;
+	snapshot->height = this->height;
+	const std::string name(filename);
+	writer.submit([snapshot, name] { snapshot->toFile(name.c_str()); });
+}
+
+void Domain::setParallel(int threads, Schedule schedule, int tile) {
+	if (tile <= 0) throw std::invalid_argument("tile needs to be positive");
+	this->threads = threads;
+	this->schedule = schedule;
+	this->tile = tile;
+}
+
+void Domain::begin_grid(const int m, const int n, const Stretching& xi, const Stretching& eta,
+	GridLines& lines) {
 	if (m <= 0 || n <= 0) throw std::invalid_argument("m and n needs to be positive");
+	if (this->boundary[0] == nullptr) throw std::invalid_argument("Domain has no boundary curves");
 	// if a grid already exists, overwrite this
+	this->coords.resize(n, m);
 	this->height = m; this->width = n;
-	this->x_coor.resize((this->height + 1)* (this->width + 1));
-	this->y_coor.resize((this->height + 1)* (this->width + 1));
-	double xi, eta;
 
-	#pragma omp parallel for private(xi, eta)
-	for (int i = 0; i < this->height + 1; ++i) {
+	Domain::prepare_lines(m, n, xi, eta, lines);
+}
+
+void Domain::prepare_lines(const int m, const int n, const Stretching& xi, const Stretching& eta,
+	GridLines& lines) {
+	lines.eta.resize(m + 1);
+	lines.xi.resize(n + 1);
+	for (int i = 0; i < m + 1; ++i)
 		// use 1 - i/m since matrices are indexed top -> bottom
-		eta = Domain::stretch(1 - i / (double) m, delta);
-	
+		lines.eta[i] = eta(1 - i / (double) m);
+	for (int j = 0; j < n + 1; ++j)
+		lines.xi[j] = xi(j / (double) n);
+
+	lines.left.resize(m + 1);
+	lines.right.resize(m + 1);
+	lines.bottom.resize(n + 1);
+	lines.top.resize(n + 1);
+}
+
+int Domain::boundary_samples() const {
+	return this->height + this->width + 3;
+}
+
+void Domain::sample_boundary(GridLines& lines, int k0, int k1) const {
+	const int m = lines.eta.size() - 1;
+	const int n = lines.xi.size() - 1;
+
+	for (int k = k0; k < k1; ++k) {
+		if (k < m + 1) {
+			lines.left[k].x = this->boundary[1]->x(1 - lines.eta[k]);
+			lines.left[k].y = this->boundary[1]->y(1 - lines.eta[k]);
+			lines.right[k].x = this->boundary[3]->x(lines.eta[k]);
+			lines.right[k].y = this->boundary[3]->y(lines.eta[k]);
+		} else if (k < m + n + 2) {
+			const int j = k - (m + 1);
+			lines.bottom[j].x = this->boundary[2]->x(lines.xi[j]);
+			lines.bottom[j].y = this->boundary[2]->y(lines.xi[j]);
+			lines.top[j].x = this->boundary[0]->x(1 - lines.xi[j]);
+			lines.top[j].y = this->boundary[0]->y(1 - lines.xi[j]);
+		} else {
+			lines.top0.x = this->boundary[0]->x(0);	lines.top0.y = this->boundary[0]->y(0);
+			lines.top1.x = this->boundary[0]->x(1);	lines.top1.y = this->boundary[0]->y(1);
+			lines.bottom0.x = this->boundary[2]->x(0);	lines.bottom0.y = this->boundary[2]->y(0);
+			lines.bottom1.x = this->boundary[2]->x(1);	lines.bottom1.y = this->boundary[2]->y(1);
+		}
+	}
+}
+
+// Transfinite interpolation of rows [i0, i1) and columns [j0, j1)
+void Domain::interpolate(const GridLines& lines, int i0, int i1, int j0, int j1) {
+	double* base = this->coords.data();
+	const size_t count = this->coords.size();
+	switch (this->coords.layout()) {
+	case CoordStorage::PLANAR:
+		this->interpolate_into<CoordStorage::PLANAR>(lines, i0, i1, j0, j1, base, count, 0);
+		break;
+	case CoordStorage::INTERLEAVED:
+		this->interpolate_into<CoordStorage::INTERLEAVED>(lines, i0, i1, j0, j1, base, count, 0);
+		break;
+	case CoordStorage::TILED:
+		this->interpolate_into<CoordStorage::TILED>(lines, i0, i1, j0, j1, base, count, 0);
+		break;
+	}
+}
+
+// Same, into a buffer of count points in layout L whose first row is grid
+// row first_row
+template <CoordStorage::Layout L>
+void Domain::interpolate_into(const GridLines& lines, int i0, int i1, int j0, int j1,
+	double* base, size_t count, int first_row) const {
+	const int w = lines.xi.size();
+	const Point* left = lines.left.data();
+	const Point* right = lines.right.data();
+	const Point* bottom = lines.bottom.data();
+	const Point* top = lines.top.data();
+	const Point top0 = lines.top0, top1 = lines.top1;
+	const Point bottom0 = lines.bottom0, bottom1 = lines.bottom1;
+
+	for (int i = i0; i < i1; ++i) {
+		const double e = lines.eta[i];
+
 		#pragma GCC ivdep
-		for (int j = 0; j < this->width + 1; ++j) {
-			xi = j / (double) n;
-			this->x_coor[j + i*(this->width + 1)] = this->phi1(xi) * this->boundary[1]->x(1 - eta)
-										+ this->phi2(xi) * this->boundary[3]->x(eta)
-										+ this->phi1(eta) * (
-											this->boundary[2]->x(xi)
-											- this->phi1(xi) * this->boundary[2]->x(0)
-											- this->phi2(xi) * this->boundary[2]->x(1)
-										)
-										+ this->phi2(eta) * (
-											this->boundary[0]->x(1 - xi)
-											- this->phi1(xi) * this->boundary[0]->x(1)
-											- this->phi2(xi) * this->boundary[0]->x(0)
-										);
-			this->y_coor[j + i*(this->width + 1)] = 
-										this->phi1(xi) * this->boundary[1]->y(1 - eta)
-										+ this->phi2(xi) * this->boundary[3]->y(eta)
-										+ this->phi1(eta) * (
-											this->boundary[2]->y(xi)
-											- this->phi1(xi) * this->boundary[2]->y(0)
-											- this->phi2(xi) * this->boundary[2]->y(1)
-										)
-										+ this->phi2(eta) * (
-											this->boundary[0]->y(1 - xi)
-											- this->phi1(xi) * this->boundary[0]->y(1)
-											- this->phi2(xi) * this->boundary[0]->y(0)
-										);
+		for (int j = j0; j < j1; ++j) {
+			const double s = lines.xi[j];
+			const size_t k = j + (size_t)(i - first_row)*w;
+			base[CoordStorage::xoff<L>(k, count)] = phi1(s) * left[i].x
+						+ phi2(s) * right[i].x
+						+ phi1(e) * (
+							bottom[j].x
+							- phi1(s) * bottom0.x
+							- phi2(s) * bottom1.x
+						)
+						+ phi2(e) * (
+							top[j].x
+							- phi1(s) * top1.x
+							- phi2(s) * top0.x
+						);
+			base[CoordStorage::yoff<L>(k, count)] = phi1(s) * left[i].y
+						+ phi2(s) * right[i].y
+						+ phi1(e) * (
+							bottom[j].y
+							- phi1(s) * bottom0.y
+							- phi2(s) * bottom1.y
+						)
+						+ phi2(e) * (
+							top[j].y
+							- phi1(s) * top1.y
+							- phi2(s) * top0.y
+						);
+		}
+	}
+}
+
+// The boundary curves only depend on eta along the sides and on xi along
+// the top and bottom, so they are sampled once per grid line here and the
+// interpolation never calls into Curvebase.
+void Domain::sample_all(GridLines& lines, int nthreads) const {
+	const int samples = lines.eta.size() + lines.xi.size() + 1;
+
+	// Exceptions may not leave an OpenMP region, keep the first one and
+	// rethrow it after the loop.
+	std::exception_ptr error = nullptr;
+
+	#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+	for (int k = 0; k < samples; ++k) {
+		try {
+			this->sample_boundary(lines, k, k + 1);
+		} catch (...) {
+			#pragma omp critical(domain_error)
+			if (!error) error = std::current_exception();
+		}
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+void Domain::generate_grid(const int m, const int n, const double delta) {
+	this->generate_grid(m, n, Stretching(), Stretching(Stretching::TANH, delta));
+}
+
+void Domain::generate_grid(const int m, const int n, const Stretching& xi, const Stretching& eta) {
+	GridLines lines;
+	this->begin_grid(m, n, xi, eta, lines);
+
+	const int nthreads = this->threads > 0 ? this->threads : omp_get_max_threads();
+	this->sample_all(lines, nthreads);
+
+	// Interpolation over 2-D tiles. The coordinates were not initialized by
+	// resize, so each page is first touched here by the thread that owns
+	// the tile. The schedule is spelled out in each pragma rather than set
+	// with omp_set_schedule, which would change it for every other
+	// parallel loop of the thread, GridBatch tasks among them.
+	const GridTiles tiles(m + 1, n + 1, this->tile);
+	const int count = tiles.size();
+
+	switch (this->schedule) {
+	case DYNAMIC:
+		#pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+		for (int k = 0; k < count; ++k) {
+			const Tile t = tiles[k];
+			this->interpolate(lines, t.i0, t.i1, t.j0, t.j1);
+		}
+		break;
+	case GUIDED:
+		#pragma omp parallel for schedule(guided) num_threads(nthreads)
+		for (int k = 0; k < count; ++k) {
+			const Tile t = tiles[k];
+			this->interpolate(lines, t.i0, t.i1, t.j0, t.j1);
+		}
+		break;
+	default:
+		#pragma omp parallel for schedule(static) num_threads(nthreads)
+		for (int k = 0; k < count; ++k) {
+			const Tile t = tiles[k];
+			this->interpolate(lines, t.i0, t.i1, t.j0, t.j1);
 		}
 	}
 }
 
-double Domain::stretch(const double sigma, const double delta) {
-	if (delta == 0)
-		return sigma;
-	return 1 + tanh(delta * (sigma - 1))/tanh(delta);
+void Domain::generate_to_file(const char* filename, const int m, const int n,
+	const Stretching& xi, const Stretching& eta, int block_rows) const {
+	if (m <= 0 || n <= 0) throw std::invalid_argument("m and n needs to be positive");
+	if (this->boundary[0] == nullptr) throw std::invalid_argument("Domain has no boundary curves");
+
+	const int w = n + 1;
+	if (block_rows <= 0)
+		block_rows = std::max(1, (1 << 20) / w);
+
+	const int nthreads = this->threads > 0 ? this->threads : omp_get_max_threads();
+	GridLines lines;
+	Domain::prepare_lines(m, n, xi, eta, lines);
+	this->sample_all(lines, nthreads);
+
+	FILE *file = fopen(filename, "wb");
+	if (file == NULL)
+		throw std::invalid_argument("Could not open grid file for writing");
+	fwrite(&n, sizeof(int), 1, file);
+	fwrite(&m, sizeof(int), 1, file);
+
+	// Two output buffers: block k is written by a background thread while
+	// block k+1 is computed into the other one. The blocks are computed
+	// interleaved, so they go to the file as they are.
+	const size_t block = (size_t)block_rows * w;
+	std::vector<double> out[2] = {std::vector<double>(2*block), std::vector<double>(2*block)};
+	std::future<bool> pending;
+
+	try {
+		int b = 0;
+		for (int i0 = 0; i0 < m + 1; i0 += block_rows, b ^= 1) {
+			const int i1 = std::min(i0 + block_rows, m + 1);
+			const size_t count = (size_t)(i1 - i0) * w;
+
+			// out[b] was handed to the writer two blocks ago, and that
+			// write was waited for before the previous block was queued.
+			double* o = out[b].data();
+			#pragma omp parallel for num_threads(nthreads) schedule(static)
+			for (int i = i0; i < i1; ++i) {
+				this->interpolate_into<CoordStorage::INTERLEAVED>(lines, i, i + 1, 0, w, o, count, i0);
+			}
+
+			if (pending.valid() && !pending.get())
+				throw std::runtime_error("Could not write grid file");
+			pending = std::async(std::launch::async, [file, o, count]() {
+				return fwrite(o, sizeof(double), 2*count, file) == 2*count;
+			});
+		}
+		if (pending.valid() && !pending.get())
+			throw std::runtime_error("Could not write grid file");
+	} catch (...) {
+		if (pending.valid()) pending.wait();
+		fclose(file);
+		throw;
+	}
+
+	fclose(file);
 }
 
 Point Domain::getPoint(int row, int col) const {
@@ -163,8 +626,8 @@ Point Domain::getPoint(int row, int col) const {
 		throw std::invalid_argument("col argument must be between 0 and this->width+1");
 
 	Point p;
-	p.x = this->x_coor[row * (this->width+1) + col];
-	p.y = this->y_coor[row * (this->width+1) + col];
+	p.x = this->coords.x(row * (this->width+1) + col);
+	p.y = this->coords.y(row * (this->width+1) + col);
 
 	return p;
 }
@@ -175,8 +638,7 @@ void Domain::setPoint(int row, int col, double x, double y){
 	if (col < 0 || this->width < col)
 		throw std::invalid_argument("col argument must be between 0 and this->width+1");
 	
-	this->x_coor[row * (this->width+1) + col] = x;
-	this->y_coor[row * (this->width+1) + col] = y;
+	this->coords.set(row * (this->width+1) + col, x, y);
 }
 
 void Domain::setPoint(int row, int col, Point p){
@@ -184,18 +646,38 @@ void Domain::setPoint(int row, int col, Point p){
 }
 
 double Domain::getX(int row, int col) const{
-	return this->x_coor[row * (this->width+1) + col];
+	return this->coords.x(row * (this->width+1) + col);
 }
 double Domain::getY(int row, int col) const{
-	return this->y_coor[row * (this->width+1) + col];
+	return this->coords.y(row * (this->width+1) + col);
 }
 
 std::vector<double> Domain::getX() const {
-	return this->x_coor;
+	if (this->coords.layout() == CoordStorage::PLANAR)
+		return std::vector<double>(this->coords.x(), this->coords.x() + this->coords.size());
+
+	std::vector<double> res(this->coords.size());
+	for (size_t k = 0; k < res.size(); ++k)
+		res[k] = this->coords.x(k);
+	return res;
 }
 
 std::vector<double> Domain::getY() const {
-	return this->y_coor;
+	if (this->coords.layout() == CoordStorage::PLANAR)
+		return std::vector<double>(this->coords.y(), this->coords.y() + this->coords.size());
+
+	std::vector<double> res(this->coords.size());
+	for (size_t k = 0; k < res.size(); ++k)
+		res[k] = this->coords.y(k);
+	return res;
+}
+
+const double* Domain::x_data() const {
+	return this->coords.x();
+}
+
+const double* Domain::y_data() const {
+	return this->coords.y();
 }
 
 double Domain::phi1(const double s) {
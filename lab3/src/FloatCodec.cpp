@@ -0,0 +1,271 @@
+#include "FloatCodec.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+// Integers in the same order as the values, so that neighbouring values
+// are neighbouring integers whatever their sign
+template <class T> struct Ordered;
+
+template <>
+struct Ordered<double> {
+	static uint64_t to(double v) {
+		uint64_t u;
+		memcpy(&u, &v, sizeof(u));
+		return (u >> 63) ? ~u : u | (1ull << 63);
+	}
+	static double from(uint64_t o) {
+		const uint64_t u = (o >> 63) ? o & ~(1ull << 63) : ~o;
+		double v;
+		memcpy(&v, &u, sizeof(v));
+		return v;
+	}
+};
+
+template <>
+struct Ordered<float> {
+	static uint64_t to(float v) {
+		uint32_t u;
+		memcpy(&u, &v, sizeof(u));
+		return (u >> 31) ? ~u : u | (1u << 31);
+	}
+	static float from(uint64_t o) {
+		uint32_t u = (uint32_t)o;
+		u = (u >> 31) ? u & ~(1u << 31) : ~u;
+		float v;
+		memcpy(&v, &u, sizeof(v));
+		return v;
+	}
+};
+
+static inline uint64_t zigzag(uint64_t r) {
+	return (r << 1) ^ (uint64_t)((int64_t)r >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t z) {
+	return (z >> 1) ^ (0 - (z & 1));
+}
+
+// BLOCK values of w bits into BLOCK*w/8 bytes at out
+static void pack(const uint64_t* z, int w, unsigned char* out) {
+	uint64_t acc = 0;
+	int fill = 0;
+	for (int k = 0; k < FloatCodec::BLOCK && w > 0; ++k) {
+		acc |= z[k] << fill;
+		fill += w;
+		if (fill >= 64) {
+			memcpy(out, &acc, sizeof(acc));
+			out += sizeof(acc);
+			fill -= 64;
+			acc = fill > 0 ? z[k] >> (w - fill) : 0;
+		}
+	}
+	memcpy(out, &acc, fill / 8);
+}
+
+// Inverse of pack for the bytes bytes at in, missing bits are zero
+static void unpack(const unsigned char* in, size_t bytes, int w, uint64_t* z) {
+	const unsigned char* end = in + bytes;
+	const uint64_t mask = w == 64 ? ~0ull : (1ull << w) - 1;
+	uint64_t acc = 0;
+	int have = 0;
+	for (int k = 0; k < FloatCodec::BLOCK; ++k) {
+		if (w == 0) {
+			z[k] = 0;
+		} else if (have >= w) {
+			z[k] = acc & mask;
+			acc = w == 64 ? 0 : acc >> w;
+			have -= w;
+		} else {
+			uint64_t next = 0;
+			if (in < end)
+				memcpy(&next, in, std::min<size_t>(sizeof(next), end - in));
+			in += sizeof(next);
+			z[k] = (acc | next << have) & mask;
+			const int used = w - have;
+			acc = used == 64 ? 0 : next >> used;
+			have = 64 - used;
+		}
+	}
+}
+
+// Residual coding of the integers a(0..n-1) after offset bytes of out
+template <class F>
+static void encode_ints(F a, size_t n, size_t offset, std::vector<unsigned char>& out) {
+	const int BLOCK = FloatCodec::BLOCK;
+	const size_t m = n - 1;
+	const size_t blocks = (m + BLOCK - 1) / BLOCK;
+	out.resize(offset + sizeof(uint64_t) + blocks + blocks * BLOCK * sizeof(uint64_t));
+
+	const uint64_t first = a(0);
+	memcpy(out.data() + offset, &first, sizeof(first));
+	unsigned char* widths = out.data() + offset + sizeof(first);
+	size_t pos = offset + sizeof(first) + blocks;
+
+	uint64_t prev = first, diff = 0;
+	uint64_t z[BLOCK];
+	for (size_t b = 0; b < blocks; ++b) {
+		const size_t k0 = 1 + b * BLOCK;
+		const int len = std::min((size_t)BLOCK, n - k0);
+		uint64_t any = 0;
+		for (int k = 0; k < len; ++k) {
+			const uint64_t v = a(k0 + k);
+			const uint64_t e = v - prev;
+			z[k] = zigzag(e - diff);
+			any |= z[k];
+			diff = e;
+			prev = v;
+		}
+		for (int k = len; k < BLOCK; ++k)
+			z[k] = 0;
+
+		const int w = any ? 64 - __builtin_clzll(any) : 0;
+		widths[b] = w;
+		pack(z, w, out.data() + pos);
+		pos += (len * w + 7) / 8; // only the last block is short
+	}
+	out.resize(pos);
+}
+
+// Inverse of encode_ints, put(k, a) receives the integers
+template <class F>
+static void decode_ints(const unsigned char* in, size_t size, size_t n, F put) {
+	const int BLOCK = FloatCodec::BLOCK;
+	const size_t m = n - 1;
+	const size_t blocks = (m + BLOCK - 1) / BLOCK;
+	if (size < sizeof(uint64_t) + blocks)
+		throw std::runtime_error("Corrupt coded float data");
+
+	uint64_t prev;
+	memcpy(&prev, in, sizeof(prev));
+	put(0, prev);
+	const unsigned char* widths = in + sizeof(prev);
+	size_t pos = sizeof(prev) + blocks;
+
+	uint64_t diff = 0;
+	uint64_t z[BLOCK];
+	for (size_t b = 0; b < blocks; ++b) {
+		const size_t k0 = 1 + b * BLOCK;
+		const int len = std::min((size_t)BLOCK, n - k0);
+		const int w = widths[b];
+		const size_t bytes = (len * w + 7) / 8;
+		if (w > 64 || pos + bytes > size)
+			throw std::runtime_error("Corrupt coded float data");
+		unpack(in + pos, bytes, w, z);
+		pos += bytes;
+		for (int k = 0; k < len; ++k) {
+			diff += unzigzag(z[k]);
+			prev += diff;
+			put(k0 + k, prev);
+		}
+	}
+	if (pos != size)
+		throw std::runtime_error("Corrupt coded float data");
+}
+
+template <class T>
+void FloatCodec::encode(const T* values, size_t n, std::vector<unsigned char>& out) {
+	out.clear();
+	if (n == 0)
+		return;
+	encode_ints([values](size_t k) { return Ordered<T>::to(values[k]); }, n, 0, out);
+}
+
+template <class T>
+void FloatCodec::decode(const unsigned char* in, size_t size, T* out, size_t n) {
+	if (n == 0) {
+		if (size != 0) throw std::runtime_error("Corrupt coded float data");
+		return;
+	}
+	decode_ints(in, size, n, [out](size_t k, uint64_t a) { out[k] = Ordered<T>::from(a); });
+}
+
+template <class T>
+void FloatCodec::quantize(const T* values, size_t n, double tolerance,
+	std::vector<unsigned char>& out) {
+	if (!(tolerance > 0)) throw std::invalid_argument("tolerance needs to be positive");
+	out.clear();
+	if (n == 0)
+		return;
+
+	double largest = 0;
+	for (size_t k = 0; k < n; ++k) {
+		if (!std::isfinite(values[k]))
+			throw std::invalid_argument("Cannot quantize values that are not finite");
+		largest = std::max(largest, (double)std::fabs(values[k]));
+	}
+
+	// The divide and the product q*step each round by half an ulp of the
+	// values, keep that much from the tolerance so the bound is strict.
+	// q must convert to double exactly, so |q| < 2^53.
+	const T big = (T)largest;
+	const double margin = 4.0 * (std::nextafter(big, (T)INFINITY) - big);
+	if (!(margin < tolerance / 2))
+		throw std::invalid_argument("Tolerance is below the precision of the values");
+	const double step = 2 * (tolerance - margin);
+	if (!(largest / step < 9.0e15))
+		throw std::invalid_argument("Values are too large for the tolerance");
+
+	encode_ints([values, step](size_t k) {
+		return (uint64_t)(int64_t)std::nearbyint(values[k] / step);
+	}, n, sizeof(step), out);
+	memcpy(out.data(), &step, sizeof(step));
+}
+
+template <class T>
+void FloatCodec::dequantize(const unsigned char* in, size_t size, T* out, size_t n) {
+	if (n == 0) {
+		if (size != 0) throw std::runtime_error("Corrupt coded float data");
+		return;
+	}
+	double step;
+	if (size < sizeof(step))
+		throw std::runtime_error("Corrupt coded float data");
+	memcpy(&step, in, sizeof(step));
+	decode_ints(in + sizeof(step), size - sizeof(step), n, [out, step](size_t k, uint64_t a) {
+		out[k] = (T)((int64_t)a * step);
+	});
+}
+
+template <class T>
+void FloatCodec::encode(const T* values, size_t n, size_t chunk, double tolerance,
+	std::vector<std::vector<unsigned char> >& out) {
+	if (chunk == 0) throw std::invalid_argument("chunk needs to be positive");
+	if (tolerance < 0) throw std::invalid_argument("tolerance needs to be non-negative");
+	const size_t count = (n + chunk - 1) / chunk;
+	out.assign(count, std::vector<unsigned char>());
+
+	// Exceptions are kept until after the loop since they may not leave
+	// the OpenMP region.
+	std::exception_ptr error = nullptr;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (size_t c = 0; c < count; ++c) {
+		const size_t len = std::min(chunk, n - c * chunk);
+		try {
+			if (tolerance > 0)
+				FloatCodec::quantize(values + c * chunk, len, tolerance, out[c]);
+			else
+				FloatCodec::encode(values + c * chunk, len, out[c]);
+		} catch (...) {
+			#pragma omp critical(floatcodec_error)
+			if (!error) error = std::current_exception();
+		}
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+template void FloatCodec::encode<double>(const double*, size_t, std::vector<unsigned char>&);
+template void FloatCodec::encode<float>(const float*, size_t, std::vector<unsigned char>&);
+template void FloatCodec::decode<double>(const unsigned char*, size_t, double*, size_t);
+template void FloatCodec::decode<float>(const unsigned char*, size_t, float*, size_t);
+template void FloatCodec::quantize<double>(const double*, size_t, double, std::vector<unsigned char>&);
+template void FloatCodec::quantize<float>(const float*, size_t, double, std::vector<unsigned char>&);
+template void FloatCodec::dequantize<double>(const unsigned char*, size_t, double*, size_t);
+template void FloatCodec::dequantize<float>(const unsigned char*, size_t, float*, size_t);
+template void FloatCodec::encode<double>(const double*, size_t, size_t, double,
+	std::vector<std::vector<unsigned char> >&);
+template void FloatCodec::encode<float>(const float*, size_t, size_t, double,
+	std::vector<std::vector<unsigned char> >&);
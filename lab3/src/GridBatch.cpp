@@ -0,0 +1,150 @@
+#include "GridBatch.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <omp.h>
+
+// Boundary samples per sampling task, each sample is a few arc length
+// inversions so a handful of them is already a sizeable task.
+static const int SAMPLE_CHUNK = 8;
+// Nodes per interpolation task
+static const int INTERPOLATE_CHUNK = 1 << 16;
+
+GridBatch::GridBatch(int threads) : threads(threads) {}
+
+int GridBatch::add(const Domain& shape, int m, int n, double delta,
+	const std::string& filename) {
+	return this->add(shape, m, n, Stretching(), Stretching(Stretching::TANH, delta), filename);
+}
+
+int GridBatch::add(const Domain& shape, int m, int n, const Stretching& xi,
+	const Stretching& eta, const std::string& filename) {
+	if (m <= 0 || n <= 0) throw std::invalid_argument("m and n needs to be positive");
+
+	Job job = {shape, m, n, xi, eta, filename, GridLines(), nullptr};
+	this->jobs.push_back(job);
+	return this->jobs.size() - 1;
+}
+
+void GridBatch::record(int job, const char* stage, double start, double t0) {
+	TaskTiming t = {job, stage, omp_get_thread_num(), start - t0, omp_get_wtime() - start};
+
+	#pragma omp critical(gridbatch_times)
+	this->times.push_back(t);
+}
+
+void GridBatch::run() {
+	const int nthreads = this->threads > 0 ? this->threads : omp_get_max_threads();
+	this->times.clear();
+
+	// Start the largest grids first, small ones fill in around them
+	std::vector<int> order(this->jobs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this](int a, int b) {
+		return (long)this->jobs[a].m * this->jobs[a].n > (long)this->jobs[b].m * this->jobs[b].n;
+	});
+
+	const double t0 = omp_get_wtime();
+
+	#pragma omp parallel num_threads(nthreads)
+	#pragma omp single
+	for (size_t o = 0; o < order.size(); ++o) {
+		const int idx = order[o];
+		Job* job = &this->jobs[idx];
+		job->error = nullptr;
+
+		#pragma omp task firstprivate(job, idx)
+		{
+			// Exceptions may not leave a task, they are kept on the job
+			try {
+				job->domain.begin_grid(job->m, job->n, job->xi, job->eta, job->lines);
+			} catch (...) {
+				job->error = std::current_exception();
+			}
+
+			// Waiting on the child tasks is a scheduling point, the thread
+			// runs other queued tasks, from this or any other grid, meanwhile.
+			const int samples = job->error ? 0 : job->domain.boundary_samples();
+			for (int k = 0; k < samples; k += SAMPLE_CHUNK) {
+				#pragma omp task firstprivate(k)
+				{
+					const double start = omp_get_wtime();
+					try {
+						job->domain.sample_boundary(job->lines, k, std::min(k + SAMPLE_CHUNK, samples));
+					} catch (...) {
+						#pragma omp critical(gridbatch_error)
+						if (!job->error) job->error = std::current_exception();
+					}
+					this->record(idx, "sample", start, t0);
+				}
+			}
+			#pragma omp taskwait
+
+			const int rows = job->m + 1;
+			const int block = std::max(1, INTERPOLATE_CHUNK / (job->n + 1));
+			for (int i = 0; i < rows && !job->error; i += block) {
+				#pragma omp task firstprivate(i)
+				{
+					const double start = omp_get_wtime();
+					job->domain.interpolate(job->lines, i, std::min(i + block, rows), 0, job->n + 1);
+					this->record(idx, "interpolate", start, t0);
+				}
+			}
+			#pragma omp taskwait
+
+			if (!job->error && !job->filename.empty()) {
+				const double start = omp_get_wtime();
+				try {
+					job->domain.toFile(job->filename.c_str());
+					this->record(idx, "write", start, t0);
+				} catch (...) {
+					job->error = std::current_exception();
+				}
+			}
+
+			// Boundary samples are not needed once the grid is filled
+			job->lines = GridLines();
+		}
+	}
+
+	for (size_t i = 0; i < this->jobs.size(); ++i) {
+		if (this->jobs[i].error) std::rethrow_exception(this->jobs[i].error);
+	}
+}
+
+const Domain& GridBatch::result(int job) const {
+	if (job < 0 || job >= (int)this->jobs.size())
+		throw std::invalid_argument("job index out of range");
+	return this->jobs[job].domain;
+}
+
+const std::vector<TaskTiming>& GridBatch::timings() const {
+	return this->times;
+}
+
+// One line per job and stage: task count, summed task time and the
+// wall-clock span from the first task start to the last task end.
+void GridBatch::printTimings(FILE* out) const {
+	const char* stages[] = {"sample", "interpolate", "write"};
+
+	fprintf(out, "%4s %9s %-12s %6s %10s %10s %10s\n",
+		"job", "grid", "stage", "tasks", "busy [s]", "first [s]", "last [s]");
+	for (size_t j = 0; j < this->jobs.size(); ++j) {
+		for (int s = 0; s < 3; ++s) {
+			int count = 0;
+			double busy = 0, first = 1e300, last = 0;
+			for (size_t t = 0; t < this->times.size(); ++t) {
+				const TaskTiming& tt = this->times[t];
+				if (tt.job != (int)j || strcmp(tt.stage, stages[s]) != 0) continue;
+				++count;
+				busy += tt.seconds;
+				first = std::min(first, tt.start);
+				last = std::max(last, tt.start + tt.seconds);
+			}
+			if (count == 0) continue;
+			fprintf(out, "%4zu %4dx%-4d %-12s %6d %10.4f %10.4f %10.4f\n",
+				j, this->jobs[j].m, this->jobs[j].n, stages[s], count, busy, first, last);
+		}
+	}
+}
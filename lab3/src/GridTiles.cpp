@@ -0,0 +1,43 @@
+#include "GridTiles.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+GridTiles::GridTiles(int rows, int cols, int tile, int halo)
+: rows(rows), cols(cols), tile(tile), halo(halo) {
+	if (rows < 0 || cols < 0) throw std::invalid_argument("Grid size must be non-negative");
+	if (tile <= 0) throw std::invalid_argument("tile needs to be positive");
+	if (halo < 0) throw std::invalid_argument("halo must be non-negative");
+
+	this->tiles_i = (rows + tile - 1) / tile;
+	this->tiles_j = (cols + tile - 1) / tile;
+}
+
+int GridTiles::size() const {
+	return this->tiles_i * this->tiles_j;
+}
+
+Tile GridTiles::operator[](int k) const {
+	if (k < 0 || k >= this->size()) throw std::invalid_argument("tile index out of range");
+
+	const int ti = k / this->tiles_j;
+	const int tj = k % this->tiles_j;
+
+	Tile t;
+	t.i0 = ti * this->tile;
+	t.i1 = std::min(t.i0 + this->tile, this->rows);
+	t.j0 = tj * this->tile;
+	t.j1 = std::min(t.j0 + this->tile, this->cols);
+	t.hi0 = std::max(t.i0 - this->halo, 0);
+	t.hi1 = std::min(t.i1 + this->halo, this->rows);
+	t.hj0 = std::max(t.j0 - this->halo, 0);
+	t.hj1 = std::min(t.j1 + this->halo, this->cols);
+	return t;
+}
+
+int GridTiles::max_halo_rows() const {
+	return std::min(this->tile + 2*this->halo, this->rows);
+}
+
+int GridTiles::max_halo_cols() const {
+	return std::min(this->tile + 2*this->halo, this->cols);
+}
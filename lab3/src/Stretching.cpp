@@ -0,0 +1,39 @@
+#include "Stretching.hpp"
+#include <stdexcept>
+#include <cmath>
+
+Stretching::Stretching(Law law, double delta) : law(law), delta(delta) {
+	if (law == ROBERTS && delta <= 1.0)
+		throw std::invalid_argument("Roberts stretching needs delta > 1");
+	if (law == GEOMETRIC && delta < 0.0)
+		throw std::invalid_argument("Geometric stretching needs delta >= 0");
+}
+
+double Stretching::operator()(const double sigma) const {
+	// delta == 0 means no stretching for the laws that allow it, the
+	// formulas below divide by zero there; Roberts never gets delta == 0
+	if (this->delta == 0)
+		return sigma;
+
+	const double d = this->delta;
+	switch (this->law) {
+	case UNIFORM:
+		return sigma;
+	case TANH:
+		return 1 + tanh(d * (sigma - 1))/tanh(d);
+	case SINH:
+		return sinh(d * sigma)/sinh(d);
+	case GEOMETRIC:
+		return expm1(d * sigma)/expm1(d);
+	case ROBERTS: {
+		const double q = pow((d + 1)/(d - 1), 1 - sigma);
+		return ((d + 1) - (d - 1) * q)/(q + 1);
+	}
+	case TWO_SIDED:
+		return 0.5 * (1 + tanh(d * (sigma - 0.5))/tanh(0.5 * d));
+	}
+	return sigma;
+}
+
+Stretching::Law Stretching::getLaw() const { return this->law; }
+double Stretching::getDelta() const { return this->delta; }
@@ -2,37 +2,94 @@
 #include <iomanip>
 #include <vector>
 #include <cstring>
+#include <omp.h>
+#include <unistd.h>
 
 #include "Curvebase.hpp"
 #include "Line.hpp"
 #include "ExpBulge.hpp"
 #include "Domain.hpp"
+#include "GridBatch.hpp"
 
 #define FILENAME_LEN 50
 
 using namespace std;
 
 
-int main(int argc, char const *argv[])
+// Batch mode: every line of specfile is "m n delta [outfile]"
+int runBatch(const char* specfile, const Domain& shape, int threads)
 {
+  FILE* specs = fopen(specfile, "r");
+  if (specs == NULL){
+    fprintf(stderr, "Could not open %s\n", specfile);
+    return 1;
+  }
+
+  GridBatch batch(threads);
+  int m, n;
+  double delta;
+  char line[256], out[FILENAME_LEN];
+  while (fgets(line, sizeof(line), specs)){
+    out[0] = '\0';
+    if (sscanf(line, "%d %d %lf %49s", &m, &n, &delta, out) < 3) continue;
+    batch.add(shape, m, n, delta, out);
+  }
+  fclose(specs);
 
+  double start = omp_get_wtime();
+  batch.run();
+  printf("Batch generated in %.4f s\n", omp_get_wtime() - start);
+  batch.printTimings();
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
   int m = 50; int n = 30;
   double delta = 0.0;
+  const char* specfile = NULL;
+  int threads = 0;
+  int mode = 0;
+  int layout = CoordStorage::PLANAR;
+  double tolerance = 0.0;
   char *file = new char[FILENAME_LEN];
   strncpy(file, "myfile.bin", FILENAME_LEN);
 
-  if (argc > 2){
-    m = atoi(argv[1]);
-    n = atoi(argv[2]);
+  // Settings as flags, the grid as before:
+  //   main [flags] [m n [delta [file]]]
+  //   -b specfile  generate every grid listed in specfile instead, see runBatch
+  //   -p threads   threads for generation, 0 uses all
+  //   -s           grids larger than memory, write row blocks as they are generated
+  //   -m           generate into a memory-mapped file that other processes can share
+  //   -c           write a compressed grid file
+  //   -e tol       with -c, coordinates within this tolerance, 0 is lossless
+  //   -l layout    0: planar, 1: interleaved, 2: tiled coordinate storage
+  int opt;
+  while ((opt = getopt(argc, argv, "b:p:smce:l:")) != -1){
+    switch (opt){
+    case 'b': specfile = optarg; break;
+    case 'p': threads = atoi(optarg); break;
+    case 's': mode = 1; break;
+    case 'm': mode = 2; break;
+    case 'c': mode = 3; break;
+    case 'e': tolerance = atof(optarg); break;
+    case 'l': layout = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-b specfile] [-p threads] [-s | -m | -c] [-e tol]"
+              " [-l layout] [m n [delta [file]]]\n", argv[0]);
+      return 1;
+    }
   }
-  if (argc > 3){
-    delta = atof(argv[3]);
+  if (argc - optind > 1){
+    m = atoi(argv[optind]);
+    n = atoi(argv[optind + 1]);
   }
-  if (argc > 4){
-    strncpy(file, argv[4], FILENAME_LEN);
+  if (argc - optind > 2){
+    delta = atof(argv[optind + 2]);
+  }
+  if (argc - optind > 3){
+    strncpy(file, argv[optind + 3], FILENAME_LEN);
   }
-
-  printf("Generating %dx%d grid\n", m, n);
 
   Line top = Line(5, 3, -1, 0, 0, 15, false);
   Line left = Line(-10, 3, 0, -1, 0, 3, false);
@@ -47,11 +104,33 @@ int main(int argc, char const *argv[])
 
   Domain myDomain = Domain(top, left, bottom, right);
   // Domain myDomain = Domain(top, right, bottom, left); // if all curves are reversed
+
+  if (specfile != NULL)
+    return runBatch(specfile, myDomain, threads);
+
+  printf("Generating %dx%d grid\n", m, n);
   
+  myDomain.setParallel(threads);
+  myDomain.setLayout((CoordStorage::Layout)layout);
+
+  double start = omp_get_wtime();
+  if (mode == 1){
+    myDomain.generate_to_file(file, m, n, Stretching(), Stretching(Stretching::TANH, delta));
+    printf("Grid streamed to %s in %.4f s\n", file, omp_get_wtime() - start);
+    return 0;
+  }
+  if (mode == 2)
+    myDomain.mapStorage(file);
   myDomain.generate_grid(m, n, delta);
+  printf("Grid generated in %.4f s on %d threads\n", omp_get_wtime() - start,
+      threads > 0 ? threads : omp_get_max_threads());
 
-  myDomain.toFile(file);
-  printf("Grid outputted to %s\n", file);
+  start = omp_get_wtime();
+  if (mode == 3)
+    myDomain.toFileCompressed(file, tolerance);
+  else
+    myDomain.toFile(file);
+  printf("Grid outputted to %s in %.4f s\n", file, omp_get_wtime() - start);
   
   return 0;
 }
\ No newline at end of file
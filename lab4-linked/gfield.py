@@ -0,0 +1,102 @@
+"""Readers for the binary field (FieldFile) and dataset (DatasetWriter)
+files. Grids and the FloatCodec decoders come from lab3/gridfile.py, the
+lab this one links its Domain from, and are available from here too."""
+import os
+import sys
+import zlib
+import numpy as np
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "lab3"))
+from gridfile import BLOCK, decode_delta, decode_quant, read_grid  # noqa: E402,F401
+
+RAW, DEFLATE, DELTA, QUANT = 0, 1, 2, 3
+
+
+def _decode_chunks(f, codec, offsets, sizes, chunk, n, dtype):
+    """Values of the chunks at offsets (None: one after the other)."""
+    parts = []
+    for c, size in enumerate(sizes):
+        if offsets is not None:
+            f.seek(int(offsets[c]))
+        data, count = f.read(int(size)), min(chunk, n - c*chunk)
+        if codec == DEFLATE:
+            parts.append(np.frombuffer(zlib.decompress(data), dtype=dtype))
+        elif codec == DELTA:
+            parts.append(decode_delta(data, count, dtype))
+        elif codec == QUANT:
+            parts.append(decode_quant(data, count, dtype))
+        else:
+            raise ValueError("unknown codec %d" % codec)
+    return np.concatenate(parts) if parts else np.zeros(0, dtype)
+
+
+def read_field(filename):
+    """Returns the values, rows x cols, and the path of their grid file."""
+    with open(filename, "rb") as f:
+        if f.read(8) != b"GFIELD1\0":
+            raise ValueError(filename + " is not a field file")
+        rows, cols, size, codec, chunk, name_len = np.fromfile(f, dtype=np.int32, count=6)
+        gridfile = f.read(name_len).decode()
+        f.seek((8 - (8 + 24 + name_len) % 8) % 8, os.SEEK_CUR)
+
+        dtype = np.float32 if size == 4 else np.float64
+        n = int(rows) * int(cols)
+        if codec == RAW:
+            values = np.fromfile(f, dtype=dtype, count=n)
+        else:
+            chunks = (n + chunk - 1) // chunk
+            sizes = np.fromfile(f, dtype=np.uint64, count=chunks)
+            values = _decode_chunks(f, codec, None, sizes, int(chunk), n, dtype)
+
+    # the grid file name is relative to the field file
+    gridfile = os.path.join(os.path.dirname(filename), gridfile)
+    return values.reshape((rows, cols)), gridfile
+
+
+def read_dataset_directory(filename):
+    """Returns {name: (rows, cols, dtype, codec, chunk, offsets, sizes)}."""
+    with open(filename, "rb") as f:
+        if f.read(8) != b"GFDATA1\0":
+            raise ValueError(filename + " is not a dataset file")
+        count, align = np.fromfile(f, dtype=np.int32, count=2)
+        dir_offset, dir_size = np.fromfile(f, dtype=np.uint64, count=2)
+        f.seek(int(dir_offset))
+        buf = f.read(int(dir_size))
+
+    entries, pos = {}, 0
+    for _ in range(count):
+        name_len = int(np.frombuffer(buf, np.int32, 1, pos)[0])
+        name = buf[pos+4:pos+4+name_len].decode()
+        pos += 4 + name_len + (8 - name_len % 8) % 8
+        rows, cols, size, codec, chunk, chunks = (int(v) for v in np.frombuffer(buf, np.int32, 6, pos))
+        pos += 24
+        offsets = np.frombuffer(buf, np.uint64, chunks, pos)
+        sizes = np.frombuffer(buf, np.uint64, chunks, pos + 8*chunks)
+        pos += 16*chunks
+        dtype = np.float32 if size == 4 else np.float64
+        entries[name] = (rows, cols, dtype, codec, chunk, offsets, sizes)
+    return entries
+
+
+def read_dataset(filename, names=None):
+    """Returns {name: values, rows x cols} for the given entry names, all
+    entries if names is None. Only the chunks of those entries are read;
+    the grid is the entries "x" and "y"."""
+    entries = read_dataset_directory(filename)
+    if names is None:
+        names = list(entries)
+
+    out = {}
+    with open(filename, "rb") as f:
+        for name in names:
+            rows, cols, dtype, codec, chunk, offsets, sizes = entries[name]
+            if rows*cols == 0:
+                values = np.zeros(0, dtype)
+            elif codec == RAW:
+                # raw chunks follow each other without gaps
+                f.seek(int(offsets[0]))
+                values = np.fromfile(f, dtype=dtype, count=rows*cols)
+            else:
+                values = _decode_chunks(f, codec, offsets, sizes, chunk, rows*cols, dtype)
+            out[name] = values.reshape((rows, cols))
+    return out
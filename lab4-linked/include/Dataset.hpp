@@ -0,0 +1,95 @@
+#ifndef DATASET_HPP
+#define DATASET_HPP
+
+#include "Matrix.hpp"
+#include "Domain.hpp"
+#include "FieldFile.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One grid and any number of named fields on it in a single file. Every
+// array is an entry of its own, split into chunks of FieldFile::CHUNK
+// values that each start on an ALIGN boundary, and a directory at the
+// end of the file tells where the chunks of each entry are, so a reader
+// seeks straight to the entries it needs. Native byte order:
+//
+//   char[8]  magic "GFDATA1"
+//   int32    number of entries, int32 alignment
+//   uint64   offset and size of the directory in bytes
+//   ...      zero padding up to ALIGN, then the chunks
+//   per entry in the directory:
+//     int32  length of the name, followed by the name zero padded to
+//            a multiple of 8 bytes
+//     int32  rows, cols, bytes per value, codec, values per chunk, chunks
+//     uint64 file offset of every chunk, then the stored size of every chunk
+//
+// The grid is stored as the entries "x" and "y", (ysize()+1) x (xsize()+1).
+// RAW chunks are whole multiples of ALIGN except the last, so a raw entry
+// is one contiguous run of values from its first chunk on.
+
+struct DatasetEntry {
+	std::string name;
+	int rows, cols;
+	int value_bytes;
+	FieldFile::Codec codec;
+	int chunk;
+	std::vector<uint64_t> offsets;
+	std::vector<uint64_t> sizes;
+};
+
+class DatasetWriter {
+
+public:
+	static const int ALIGN = 4096;
+
+	// tolerance for the QUANT codec, see FieldFile::write
+	DatasetWriter(const char* filename, FieldFile::Codec codec=FieldFile::RAW,
+		double tolerance=0.0);
+	// Writes the directory if close was not called, errors are lost then
+	~DatasetWriter();
+
+	// The grid, stored as the entries "x" and "y"
+	void add(const Domain& grid);
+	template <class T>
+	void add(const char* name, const T* values, int rows, int cols);
+	template <class T>
+	void add(const char* name, const BasicMatrix<T>& values);
+
+	// Writes the directory and closes the file
+	void close();
+
+private:
+	DatasetWriter(const DatasetWriter&);
+	DatasetWriter& operator=(const DatasetWriter&);
+
+	FILE* file;
+	FieldFile::Codec codec;
+	double tolerance;
+	uint64_t end;
+	std::vector<DatasetEntry> entries;
+
+	bool put(const void* data, size_t size);
+};
+
+class DatasetReader {
+
+public:
+	explicit DatasetReader(const char* filename);
+
+	const std::vector<DatasetEntry>& entries() const;
+	bool has(const char* name) const;
+	const DatasetEntry& entry(const char* name) const;
+
+	// Reads only the chunks of one entry, converted to T if it was
+	// stored in the other precision
+	template <class T>
+	BasicMatrix<T> read(const char* name) const;
+
+private:
+	std::string filename;
+	std::vector<DatasetEntry> dir;
+};
+
+#endif //DATASET_HPP
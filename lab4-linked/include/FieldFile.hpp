@@ -0,0 +1,51 @@
+#ifndef FIELDFILE_HPP
+#define FIELDFILE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Binary file with the values of one grid function. The coordinates are
+// not repeated, the file names the grid file (Domain::toFile format) the
+// values belong to. Layout, native byte order:
+//
+//   char[8]  magic "GFIELD1"
+//   int32    rows, cols
+//   int32    bytes per value, 4 (float) or 8 (double)
+//   int32    codec
+//   int32    values per chunk
+//   int32    length of the grid file name, followed by the name, zero
+//            padded so the data starts at a multiple of 8 bytes
+//   RAW      rows*cols values, row-major
+//   others   uint64 stored size of every chunk, then the chunks, each
+//            coded on its own so they are coded and decoded in parallel
+class FieldFile {
+
+public:
+	enum Codec {
+		RAW,     // values as they are, one write
+		DEFLATE, // zlib per chunk
+		DELTA,   // lossless predictive float coding per chunk, see FloatCodec
+		QUANT    // FloatCodec::quantize per chunk, lossy within a tolerance
+	};
+
+	// Values per chunk, 512 KiB of doubles
+	static const int CHUNK = 1 << 16;
+
+	// tolerance is the largest change of a value QUANT may make
+	template <class T>
+	static void write(const char* filename, const char* gridfile,
+		const T* values, int rows, int cols, Codec codec=RAW, double tolerance=0.0);
+
+	// Codes n values in chunks of CHUNK values, all chunks in parallel.
+	// Also used by the Dataset container.
+	template <class T>
+	static void encode(const T* values, size_t n, Codec codec,
+		std::vector<std::vector<unsigned char> >& chunks, double tolerance=0.0);
+	// Decodes one stored chunk of size bytes into the n values at out
+	template <class T>
+	static void decode(Codec codec, const unsigned char* in, size_t size,
+		T* out, size_t n);
+};
+
+#endif //FIELDFILE_HPP
@@ -3,50 +3,181 @@
 
 #include "Matrix.hpp"
 #include "Domain.hpp"
+#include "FieldFile.hpp"
+#include "Dataset.hpp"
 #include <memory>
+#include <vector>
 
-class GFkt {
+// Grid function with values of type T on a Domain. The grid and the
+// metric terms (coordinate derivatives, 1/det J) are always double, so
+// BasicGFkt<float> only stores and differentiates the field in float.
+template <class T>
+class BasicGFkt {
   private:
-    Matrix u;
+    BasicMatrix<T> u;
     std::shared_ptr<Domain> grid;
-    GFkt du_dxi() const;
-    GFkt du_deta() const;
-    GFkt dphix_dxi() const;
-    GFkt dphiy_dxi() const;
-    GFkt dphix_deta() const;
-    GFkt dphiy_deta() const;
-    GFkt detJinv() const;
+    BasicGFkt du_dxi() const;
+    BasicGFkt du_deta() const;
+    Matrix dphix_dxi() const;
+    Matrix dphiy_dxi() const;
+    Matrix dphix_deta() const;
+    Matrix dphiy_deta() const;
+    Matrix detJinv() const;
+
+    // Tile edge for du_dx, du_dy and Laplace, 0 works on the whole grid
+    int tile;
+
+  public:
+    enum Operator { DX, DY, LAPLACE };
+
+    // Differences for d/dxi and d/deta of u and of the coordinates.
+    // SECOND: central differences, one-sided on the boundary.
+    // EXPLICIT4, EXPLICIT6: wider central stencils of 4th and 6th order,
+    // one-sided stencils of the same order near the boundary.
+    // COMPACT4, COMPACT6: Pade schemes, a tridiagonal solve along every
+    // grid line gives 4th and 6th order from three and five point
+    // stencils, with a 4th order closure on the boundary.
+    enum Scheme { SECOND, EXPLICIT4, EXPLICIT6, COMPACT4, COMPACT6 };
+
+  private:
+    Scheme scheme;
+
+  public:
+
+    // Several of them computed together, see below
+    class Derivatives;
+
+  private:
+    BasicGFkt tiled(const Operator op, const int k, const double dt) const;
+    // want[op] of du_dx, du_dy and Laplace into out[op] in one pass
+    void evaluate(const bool* want, BasicGFkt* const* out) const;
+
+    template <class U> friend class BasicGFkt;
+
+    // Coordinate plane of the grid, gathered into tmp unless it is PLANAR
+    const double* coordinates(const bool x, std::vector<double>& tmp) const;
 
   public:
-    GFkt(std::shared_ptr<Domain> _grid);
-    GFkt(const GFkt& gf);
+    BasicGFkt(std::shared_ptr<Domain> _grid);
+    BasicGFkt(const BasicGFkt& gf);
+    // Same function in another precision
+    template <class U>
+    explicit BasicGFkt(const BasicGFkt<U>& gf);
 
-    GFkt& operator=(const GFkt& gf);
-    
-    const GFkt& operator+=(const GFkt& gf);
-    const GFkt operator+(const GFkt& gf) const;
+    BasicGFkt& operator=(const BasicGFkt& gf);
 
-    const GFkt& operator-=(const GFkt& gf);
-    const GFkt operator-(const GFkt& gf) const;
+    // tile > 0 runs du_dx, du_dy and Laplace tile x tile nodes at a time
+    // so the intermediate results stay in cache, 0 (default) works on the
+    // whole grid. Results are the same either way.
+    void setTiling(const int tile);
+    // SECOND (default) or a higher order scheme for every derivative.
+    // Tiling applies to SECOND only, the other schemes work on whole
+    // grids. They need at least 8 nodes along each grid line.
+    void setScheme(const Scheme scheme);
 
-    const GFkt& operator*=(const double k);
-    const GFkt operator*(const GFkt& gf) const;
-    const GFkt operator*(const double k) const;
-    const friend GFkt operator*(const double k, GFkt& gf);
-    
-    const GFkt& operator/=(const double k);
-    const GFkt operator/(const double k) const;
+    const BasicGFkt& operator+=(const BasicGFkt& gf);
+    const BasicGFkt operator+(const BasicGFkt& gf) const;
+
+    const BasicGFkt& operator-=(const BasicGFkt& gf);
+    const BasicGFkt operator-(const BasicGFkt& gf) const;
+
+    const BasicGFkt& operator*=(const double k);
+    const BasicGFkt operator*(const BasicGFkt& gf) const;
+    const BasicGFkt operator*(const double k) const;
+    friend const BasicGFkt operator*(const double k, BasicGFkt& gf) { return gf * k; }
+
+    const BasicGFkt& operator/=(const double k);
+    const BasicGFkt operator/(const double k) const;
 
     // ~GFkt(); not needed since we use std::shared_ptr<Domain> for grid
 
-    void set_values(double (*f)(double x, double y));
-    void set_values(Matrix _u);
-    GFkt du_dx() const;
-    GFkt du_dy() const;
-    GFkt Laplace() const;
-    Matrix get_values() const;
+    // u = f(x, y) node by node. f is any callable, inlined into a
+    // parallel loop over rows and a SIMD loop along each row.
+    template <class F>
+    auto set_values(F&& f) -> decltype((void)f(0.0, 0.0));
+    // Row at a time: f(x, y, u, n) fills u[0..n) of one grid row from the
+    // coordinates x[0..n), y[0..n) of that row. Rows run in parallel.
+    template <class F>
+    auto set_values(F&& f) -> decltype((void)f((const double*)0, (const double*)0, (T*)0, 0));
+    void set_values(BasicMatrix<T> _u);
+    BasicGFkt du_dx() const;
+    BasicGFkt du_dy() const;
+    BasicGFkt Laplace() const;
+    // op applied k times, u <- op(u), or k explicit Euler steps
+    // u <- u + dt*op(u) when dt != 0. With tiling the k steps are done
+    // tile by tile in one pass over the grid.
+    BasicGFkt iterate(const Operator op, const int k, const double dt=0.0) const;
+    BasicMatrix<T> get_values() const;
 
     void toFile(const char* filename) const;
+    // Binary values only, FieldFile format, on the grid written to gridfile.
+    // tolerance bounds the error of the lossy QUANT codec.
+    void toFile(const char* filename, const char* gridfile,
+                const FieldFile::Codec codec=FieldFile::RAW,
+                const double tolerance=0.0) const;
+    // Same file, written on the writer's thread from a copy of the values
+    // taken now. Errors show up at writer.flush().
+    void toFile(const char* filename, const char* gridfile, AsyncWriter& writer,
+                const FieldFile::Codec codec=FieldFile::RAW,
+                const double tolerance=0.0) const;
+    // Values as the entry name of a dataset, next to the grid and other fields
+    void toFile(DatasetWriter& out, const char* name) const;
 };
 
-#endif
\ No newline at end of file
+template <class T>
+template <class F>
+auto BasicGFkt<T>::set_values(F&& f) -> decltype((void)f(0.0, 0.0)) {
+  set_values([&f](const double* x, const double* y, T* row, const int n) {
+    #pragma omp simd
+    for (int j = 0; j < n; ++j) {
+      row[j] = (T)f(x[j], y[j]);
+    }
+  });
+}
+
+template <class T>
+template <class F>
+auto BasicGFkt<T>::set_values(F&& f)
+    -> decltype((void)f((const double*)0, (const double*)0, (T*)0, 0)) {
+  std::vector<double> xbuf, ybuf;
+  const double* x = coordinates(true, xbuf);
+  const double* y = coordinates(false, ybuf);
+  const int rows = grid->ysize() + 1;
+  const int cols = grid->xsize() + 1;
+  T* out = u.getArray();
+
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < rows; ++i) {
+    const size_t k = (size_t)i * cols;
+    f(x + k, y + k, out + k, cols);
+  }
+}
+
+// Deferred derivatives of one grid function. request() only records an
+// operator, evaluate() then computes every requested one in a single pass
+// over the grid, tile by tile, and shares what they have in common: the
+// metric terms, the xi and eta differences of u, and du/dx and du/dy,
+// which the Laplacian differentiates once more. Results are the same as
+// du_dx(), du_dy() and Laplace() one at a time. f must outlive the
+// object, its values are read when evaluate() runs.
+template <class T>
+class BasicGFkt<T>::Derivatives {
+  public:
+    explicit Derivatives(const BasicGFkt& f);
+
+    Derivatives& request(const Operator op);
+    // Computes the requested results that are not computed yet
+    void evaluate();
+    // Result of op, requested and evaluated first if it is missing
+    const BasicGFkt& operator[](const Operator op);
+
+  private:
+    const BasicGFkt& f;
+    bool wanted[3];
+    std::unique_ptr<BasicGFkt> result[3];
+};
+
+typedef BasicGFkt<double> GFkt;
+typedef BasicGFkt<float> FGFkt;
+
+#endif
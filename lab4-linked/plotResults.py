@@ -1,6 +1,7 @@
 import numpy as np
 from matplotlib import pyplot as plt
 from mpl_toolkits import mplot3d
+import gfield
 
 def true_vals(x, y, mode):
     if mode == "xder":
@@ -16,21 +17,14 @@ def main():
     title = [r"$u(x_i,y_i)$", r"$u'_x(x_i,y_i)$", r"$u'_y(x_i,y_i)$", r"$\Delta u (x_i,y_i)$"]
     # variants = ["u", "xder"]
 
-    for i, filename_base in enumerate(variants):
-        filename = filename_base + ".txt"
-        with open(filename, 'r') as f:
-            lines = list(f.readlines())
-            rows, cols = lines[0].split(", ")
-            lines = lines[1:]
-            lines = np.vstack(tuple(line.strip("\n").split(", ") for line in lines))
-            data = np.array(lines, dtype='float32')
+    grid = gfield.read_dataset("results.gfd", ["x", "y"])
+    x, y = grid["x"].ravel(), grid["y"].ravel()
+
+    for i, name in enumerate(variants):
+        z = gfield.read_dataset("results.gfd", [name])[name].ravel()
 
         fig = plt.figure()
         ax = plt.axes(projection='3d')
-
-        x = data[:,0]
-        y = data[:,1]
-        z = data[:,2]
         
         ax.scatter(x, y, z, c=clrs[i], label="Numerical")
         if i > 0:
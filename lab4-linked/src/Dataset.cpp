@@ -0,0 +1,280 @@
+#include "Dataset.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char MAGIC[8] = "GFDATA1";
+static const size_t HEADER_BYTES = sizeof(MAGIC) + 2*sizeof(int32_t) + 2*sizeof(uint64_t);
+
+DatasetWriter::DatasetWriter(const char* filename, FieldFile::Codec codec, double tolerance)
+: file(NULL), codec(codec), tolerance(tolerance), end(0) {
+	if (codec < FieldFile::RAW || codec > FieldFile::QUANT)
+		throw std::invalid_argument("Unknown field codec");
+	if (codec == FieldFile::QUANT && !(tolerance > 0))
+		throw std::invalid_argument("QUANT needs a positive tolerance");
+	this->file = fopen(filename, "wb");
+	if (this->file == NULL)
+		throw std::invalid_argument("Could not open dataset file for writing");
+
+	// The header is written again by close, once the directory is known
+	const std::vector<char> head(ALIGN, '\0');
+	if (!this->put(head.data(), head.size())) {
+		fclose(this->file);
+		throw std::runtime_error("Could not write dataset file");
+	}
+}
+
+DatasetWriter::~DatasetWriter() {
+	try {
+		this->close();
+	} catch (...) {
+	}
+}
+
+bool DatasetWriter::put(const void* data, size_t size) {
+	this->end += size;
+	return fwrite(data, 1, size, this->file) == size;
+}
+
+void DatasetWriter::add(const Domain& grid) {
+	const int rows = grid.ysize() + 1;
+	const int cols = grid.xsize() + 1;
+	if (grid.layout() == CoordStorage::PLANAR) {
+		this->add("x", grid.x_data(), rows, cols);
+		this->add("y", grid.y_data(), rows, cols);
+	} else {
+		this->add("x", grid.getX().data(), rows, cols);
+		this->add("y", grid.getY().data(), rows, cols);
+	}
+}
+
+template <class T>
+void DatasetWriter::add(const char* name, const BasicMatrix<T>& values) {
+	this->add(name, values.getArray(), values.getRows(), values.getCols());
+}
+
+template <class T>
+void DatasetWriter::add(const char* name, const T* values, int rows, int cols) {
+	if (this->file == NULL) throw std::logic_error("Dataset is already closed");
+	if (rows < 0 || cols < 0) throw std::invalid_argument("Field size must be non-negative");
+	for (size_t e = 0; e < this->entries.size(); ++e)
+		if (this->entries[e].name == name)
+			throw std::invalid_argument("Dataset already has an entry of that name");
+
+	const size_t n = (size_t)rows * cols;
+	const size_t chunks = (n + FieldFile::CHUNK - 1) / FieldFile::CHUNK;
+	DatasetEntry entry = {name, rows, cols, (int)sizeof(T), this->codec, FieldFile::CHUNK,
+		std::vector<uint64_t>(chunks), std::vector<uint64_t>(chunks)};
+
+	std::vector<std::vector<unsigned char> > coded;
+	if (this->codec != FieldFile::RAW)
+		FieldFile::encode(values, n, this->codec, coded, this->tolerance);
+
+	const std::vector<char> pad(ALIGN, '\0');
+	bool ok = true;
+	for (size_t c = 0; ok && c < chunks; ++c) {
+		const size_t skip = (ALIGN - this->end % ALIGN) % ALIGN;
+		ok = this->put(pad.data(), skip);
+		entry.offsets[c] = this->end;
+		if (this->codec == FieldFile::RAW) {
+			entry.sizes[c] = std::min((size_t)FieldFile::CHUNK, n - c*FieldFile::CHUNK) * sizeof(T);
+			ok = ok && this->put(values + c*FieldFile::CHUNK, entry.sizes[c]);
+		} else {
+			entry.sizes[c] = coded[c].size();
+			ok = ok && this->put(coded[c].data(), coded[c].size());
+		}
+	}
+	if (!ok)
+		throw std::runtime_error("Could not write dataset file");
+	this->entries.push_back(entry);
+}
+
+void DatasetWriter::close() {
+	if (this->file == NULL)
+		return;
+
+	const uint64_t dir_offset = this->end;
+	bool ok = true;
+	for (size_t e = 0; ok && e < this->entries.size(); ++e) {
+		const DatasetEntry& entry = this->entries[e];
+		const int32_t name_len = entry.name.size();
+		const std::string pad((8 - name_len % 8) % 8, '\0');
+		const int32_t head[6] = {entry.rows, entry.cols, entry.value_bytes,
+			(int32_t)entry.codec, entry.chunk, (int32_t)entry.offsets.size()};
+		ok = this->put(&name_len, sizeof(name_len))
+			&& this->put(entry.name.data(), name_len)
+			&& this->put(pad.data(), pad.size())
+			&& this->put(head, sizeof(head))
+			&& this->put(entry.offsets.data(), entry.offsets.size()*sizeof(uint64_t))
+			&& this->put(entry.sizes.data(), entry.sizes.size()*sizeof(uint64_t));
+	}
+
+	const int32_t counts[2] = {(int32_t)this->entries.size(), ALIGN};
+	const uint64_t dir[2] = {dir_offset, this->end - dir_offset};
+	ok = ok && fseek(this->file, 0, SEEK_SET) == 0
+		&& fwrite(MAGIC, 1, sizeof(MAGIC), this->file) == sizeof(MAGIC)
+		&& fwrite(counts, sizeof(int32_t), 2, this->file) == 2
+		&& fwrite(dir, sizeof(uint64_t), 2, this->file) == 2;
+
+	ok = fclose(this->file) == 0 && ok;
+	this->file = NULL;
+	if (!ok)
+		throw std::runtime_error("Could not write dataset file");
+}
+
+// Reads size bytes at offset, throws on a short read
+static void read_at(int fd, void* out, size_t size, uint64_t offset) {
+	char* p = (char*)out;
+	while (size > 0) {
+		const ssize_t got = pread(fd, p, size, offset);
+		if (got <= 0) throw std::runtime_error("Dataset file is truncated");
+		p += got;
+		size -= got;
+		offset += got;
+	}
+}
+
+template <class T>
+static T take(const std::vector<char>& buf, size_t& pos) {
+	if (pos + sizeof(T) > buf.size()) throw std::runtime_error("Dataset directory is truncated");
+	T value;
+	memcpy(&value, buf.data() + pos, sizeof(T));
+	pos += sizeof(T);
+	return value;
+}
+
+DatasetReader::DatasetReader(const char* filename) : filename(filename) {
+	const int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		throw std::invalid_argument("Could not open dataset file");
+
+	try {
+		std::vector<char> head(HEADER_BYTES);
+		read_at(fd, head.data(), head.size(), 0);
+		if (memcmp(head.data(), MAGIC, sizeof(MAGIC)) != 0)
+			throw std::invalid_argument("Not a dataset file");
+		size_t pos = sizeof(MAGIC);
+		const int32_t count = take<int32_t>(head, pos);
+		take<int32_t>(head, pos); // alignment, only needed by writers
+		const uint64_t dir_offset = take<uint64_t>(head, pos);
+		const uint64_t dir_size = take<uint64_t>(head, pos);
+
+		std::vector<char> buf(dir_size);
+		read_at(fd, buf.data(), buf.size(), dir_offset);
+		pos = 0;
+		for (int e = 0; e < count; ++e) {
+			DatasetEntry entry;
+			const int32_t name_len = take<int32_t>(buf, pos);
+			if (name_len < 0 || pos + name_len > buf.size())
+				throw std::runtime_error("Dataset directory is truncated");
+			entry.name.assign(buf.data() + pos, name_len);
+			pos += name_len + (8 - name_len % 8) % 8;
+			entry.rows = take<int32_t>(buf, pos);
+			entry.cols = take<int32_t>(buf, pos);
+			entry.value_bytes = take<int32_t>(buf, pos);
+			entry.codec = (FieldFile::Codec)take<int32_t>(buf, pos);
+			entry.chunk = take<int32_t>(buf, pos);
+			const int32_t chunks = take<int32_t>(buf, pos);
+			if (chunks < 0 || entry.chunk <= 0)
+				throw std::runtime_error("Dataset directory is corrupt");
+			entry.offsets.resize(chunks);
+			entry.sizes.resize(chunks);
+			for (int c = 0; c < chunks; ++c)
+				entry.offsets[c] = take<uint64_t>(buf, pos);
+			for (int c = 0; c < chunks; ++c)
+				entry.sizes[c] = take<uint64_t>(buf, pos);
+			this->dir.push_back(entry);
+		}
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+}
+
+const std::vector<DatasetEntry>& DatasetReader::entries() const {
+	return this->dir;
+}
+
+bool DatasetReader::has(const char* name) const {
+	for (size_t e = 0; e < this->dir.size(); ++e)
+		if (this->dir[e].name == name) return true;
+	return false;
+}
+
+const DatasetEntry& DatasetReader::entry(const char* name) const {
+	for (size_t e = 0; e < this->dir.size(); ++e)
+		if (this->dir[e].name == name) return this->dir[e];
+	throw std::invalid_argument("Dataset has no entry of that name");
+}
+
+// Decodes the chunks of entry into out, chunks in parallel
+template <class S>
+static void read_entry(int fd, const DatasetEntry& entry, S* out) {
+	const size_t n = (size_t)entry.rows * entry.cols;
+	const size_t chunks = entry.offsets.size();
+	if (chunks != (n + entry.chunk - 1) / entry.chunk)
+		throw std::runtime_error("Dataset directory is corrupt");
+
+	std::exception_ptr error = nullptr;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (size_t c = 0; c < chunks; ++c) {
+		const size_t len = std::min((size_t)entry.chunk, n - c*entry.chunk) * sizeof(S);
+		try {
+			if (entry.codec == FieldFile::RAW) {
+				if (entry.sizes[c] != len) throw std::runtime_error("Dataset directory is corrupt");
+				read_at(fd, out + c*entry.chunk, len, entry.offsets[c]);
+			} else {
+				std::vector<unsigned char> buf(entry.sizes[c]);
+				read_at(fd, buf.data(), buf.size(), entry.offsets[c]);
+				FieldFile::decode(entry.codec, buf.data(), buf.size(),
+					out + c*entry.chunk, len / sizeof(S));
+			}
+		} catch (...) {
+			#pragma omp critical(dataset_error)
+			if (!error) error = std::current_exception();
+		}
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+template <class T>
+BasicMatrix<T> DatasetReader::read(const char* name) const {
+	const DatasetEntry& entry = this->entry(name);
+	const int fd = open(this->filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::invalid_argument("Could not open dataset file");
+
+	BasicMatrix<T> res(entry.rows, entry.cols);
+	try {
+		if (entry.value_bytes == sizeof(T)) {
+			read_entry(fd, entry, res.getArray());
+		} else if (entry.value_bytes == sizeof(float)) {
+			BasicMatrix<float> tmp(entry.rows, entry.cols);
+			read_entry(fd, entry, tmp.getArray());
+			res = BasicMatrix<T>(tmp);
+		} else if (entry.value_bytes == sizeof(double)) {
+			BasicMatrix<double> tmp(entry.rows, entry.cols);
+			read_entry(fd, entry, tmp.getArray());
+			res = BasicMatrix<T>(tmp);
+		} else {
+			throw std::runtime_error("Unsupported value size in dataset");
+		}
+	} catch (...) {
+		close(fd);
+		throw;
+	}
+	close(fd);
+	return res;
+}
+
+template void DatasetWriter::add<double>(const char*, const double*, int, int);
+template void DatasetWriter::add<float>(const char*, const float*, int, int);
+template void DatasetWriter::add<double>(const char*, const BasicMatrix<double>&);
+template void DatasetWriter::add<float>(const char*, const BasicMatrix<float>&);
+template BasicMatrix<double> DatasetReader::read<double>(const char*) const;
+template BasicMatrix<float> DatasetReader::read<float>(const char*) const;
@@ -0,0 +1,142 @@
+#include "FieldFile.hpp"
+#include "FloatCodec.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <zlib.h>
+
+static const char MAGIC[8] = "GFIELD1";
+
+// Stored form of one chunk of n values
+template <class T>
+static void encode_chunk(FieldFile::Codec codec, const T* in, size_t n,
+	double tolerance, std::vector<unsigned char>& out) {
+	switch (codec) {
+	case FieldFile::DEFLATE: {
+		const uLong len = n*sizeof(T);
+		uLongf size = compressBound(len);
+		out.resize(size);
+		if (compress2(out.data(), &size, (const Bytef*)in, len, Z_BEST_SPEED) != Z_OK)
+			throw std::runtime_error("Could not compress field chunk");
+		out.resize(size);
+		return;
+	}
+	case FieldFile::DELTA:
+		FloatCodec::encode(in, n, out);
+		return;
+	case FieldFile::QUANT:
+		FloatCodec::quantize(in, n, tolerance, out);
+		return;
+	default:
+		throw std::invalid_argument("Unknown field codec");
+	}
+}
+
+template <class T>
+void FieldFile::encode(const T* values, size_t n, Codec codec,
+	std::vector<std::vector<unsigned char> >& chunks, double tolerance) {
+	const size_t count = (n + CHUNK - 1) / CHUNK;
+	chunks.assign(count, std::vector<unsigned char>());
+
+	// Exceptions are kept until after the loop since they may not leave
+	// the OpenMP region.
+	std::exception_ptr error = nullptr;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (size_t c = 0; c < count; ++c) {
+		const size_t len = std::min((size_t)CHUNK, n - c*CHUNK);
+		try {
+			encode_chunk(codec, values + c*CHUNK, len, tolerance, chunks[c]);
+		} catch (...) {
+			#pragma omp critical(fieldfile_error)
+			if (!error) error = std::current_exception();
+		}
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+template <class T>
+void FieldFile::decode(Codec codec, const unsigned char* in, size_t size,
+	T* out, size_t n) {
+	const size_t len = n*sizeof(T);
+	switch (codec) {
+	case RAW:
+		if (size != len) throw std::runtime_error("Field chunk has the wrong size");
+		memcpy(out, in, len);
+		return;
+	case DEFLATE: {
+		uLongf got = len;
+		if (uncompress((Bytef*)out, &got, in, size) != Z_OK || got != len)
+			throw std::runtime_error("Could not decompress field chunk");
+		return;
+	}
+	case DELTA:
+		FloatCodec::decode(in, size, out, n);
+		return;
+	case QUANT:
+		FloatCodec::dequantize(in, size, out, n);
+		return;
+	default:
+		throw std::invalid_argument("Unknown field codec");
+	}
+}
+
+template <class T>
+void FieldFile::write(const char* filename, const char* gridfile,
+	const T* values, int rows, int cols, Codec codec, double tolerance) {
+	if (rows < 0 || cols < 0) throw std::invalid_argument("Field size must be non-negative");
+	if (codec < RAW || codec > QUANT) throw std::invalid_argument("Unknown field codec");
+	if (codec == QUANT && !(tolerance > 0)) throw std::invalid_argument("QUANT needs a positive tolerance");
+
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+		throw std::invalid_argument("Could not open field file for writing");
+
+	const int name_len = strlen(gridfile);
+	const int head[6] = {rows, cols, (int)sizeof(T), (int)codec, CHUNK, name_len};
+	const size_t used = sizeof(MAGIC) + sizeof(head) + name_len;
+	const std::string pad((8 - used % 8) % 8, '\0');
+
+	const size_t n = (size_t)rows * cols;
+	const size_t chunks = (n + CHUNK - 1) / CHUNK;
+	bool ok = fwrite(MAGIC, 1, sizeof(MAGIC), file) == sizeof(MAGIC)
+		&& fwrite(head, sizeof(int), 6, file) == 6
+		&& fwrite(gridfile, 1, name_len, file) == (size_t)name_len
+		&& fwrite(pad.data(), 1, pad.size(), file) == pad.size();
+
+	if (ok && codec == RAW) {
+		ok = fwrite(values, sizeof(T), n, file) == n;
+	} else if (ok) {
+		std::vector<std::vector<unsigned char> > coded;
+		try {
+			FieldFile::encode(values, n, codec, coded, tolerance);
+		} catch (...) {
+			fclose(file);
+			throw;
+		}
+
+		std::vector<uint64_t> sizes(chunks);
+		for (size_t c = 0; c < chunks; ++c)
+			sizes[c] = coded[c].size();
+		ok = fwrite(sizes.data(), sizeof(uint64_t), chunks, file) == chunks;
+		for (size_t c = 0; ok && c < chunks; ++c)
+			ok = fwrite(coded[c].data(), 1, coded[c].size(), file) == coded[c].size();
+	}
+
+	fclose(file);
+	if (!ok)
+		throw std::runtime_error("Could not write field file");
+}
+
+template void FieldFile::encode<double>(const double*, size_t, Codec,
+	std::vector<std::vector<unsigned char> >&, double);
+template void FieldFile::encode<float>(const float*, size_t, Codec,
+	std::vector<std::vector<unsigned char> >&, double);
+template void FieldFile::decode<double>(Codec, const unsigned char*, size_t, double*, size_t);
+template void FieldFile::decode<float>(Codec, const unsigned char*, size_t, float*, size_t);
+template void FieldFile::write<double>(const char*, const char*, const double*, int, int, Codec, double);
+template void FieldFile::write<float>(const char*, const char*, const float*, int, int, Codec, double);
@@ -1,5 +1,7 @@
 #include "GFkt.hpp"
 #include "Matrix.hpp"
+#include "Tridiagonal.hpp"
+#include "GridTiles.hpp"
 
 #include <iostream>
 #include <memory>
@@ -7,270 +9,847 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+// Derivative kernels along one grid row with unit grid spacing h.
+// Central differences inside, the second order one-sided formula
+// -(3f0 - 4f1 + f2)/(2h) towards the interior on the grid boundary.
+// Both directions work row by row so the inner loop is contiguous and
+// vectorizable, the boundary nodes are peeled off it. The same kernels
+// run on whole grids and on the halo blocks of tiles. lab4/GFkt.cpp has
+// a whole-grid copy of them, keep the two in step.
+
+// d/dxi for the columns [j0, j1) of a grid with cols columns. r and o
+// point at column j0, r must hold every neighbour the stencils reach.
+template <class T>
+static void diff_xi_row(const T* r, T* o, const int j0, const int j1, const int cols, const T h) {
+  const T c = 1/(2*h);
+  int a = j0, b = j1;
+
+  if (a == 0) {
+    o[0] = -c * (3*r[0] - 4*r[1] + r[2]);
+    ++a;
+  }
+  if (b == cols) {
+    --b;
+    const T* e = r + (b - j0);
+    o[b - j0] = c * (3*e[0] - 4*e[-1] + e[-2]);
+  }
+  #pragma omp simd
+  for (int j = a - j0; j < b - j0; ++j) {
+    o[j] = c * (r[j+1] - r[j-1]);
+  }
+}
 
-GFkt::GFkt(std::shared_ptr<Domain> _grid) : u(_grid->ysize()+1, _grid->xsize()+1),
-                                            grid(_grid) { } 
-GFkt::GFkt(const GFkt& gf) : u(gf.u), grid(gf.grid) { }
+// d/deta for n nodes of grid row i out of rows. in points at the first of
+// them, the neighbouring rows are ld apart.
+template <class T>
+static void diff_eta_row(const T* in, const long ld, T* o, const int i, const int rows,
+                         const int n, const T h) {
+  const T c = 1/(2*h);
+
+  if (i == 0 || i == rows - 1) {
+    // one-sided, towards the interior
+    const long s = (i == 0) ? ld : -ld;
+    const T c1 = (i == 0) ? -c : c;
+    const T* r1 = in + s;
+    const T* r2 = in + 2*s;
+    #pragma omp simd
+    for (int j = 0; j < n; ++j) {
+      o[j] = c1 * (3*in[j] - 4*r1[j] + r2[j]);
+    }
+  } else {
+    const T* up = in + ld;
+    const T* down = in - ld;
+    #pragma omp simd
+    for (int j = 0; j < n; ++j) {
+      o[j] = c * (up[j] - down[j]);
+    }
+  }
+}
 
-GFkt GFkt::detJinv() const {
-  GFkt tmp = (dphix_dxi() * dphiy_deta()) - (dphiy_dxi() * dphix_deta());
-  Matrix vals = tmp.get_values();
+// Higher order schemes along a grid line of n nodes with spacing h,
+// A f' = B f / h. B is the antisymmetric stencil c inside and the
+// one-sided rows b on the first r nodes, mirrored with the opposite sign
+// on the last r. A is the identity for explicit schemes and tridiagonal
+// (alpha, 1, alpha) inside for compact ones, with the rows lhs (lower,
+// diagonal, upper) on the first r nodes.
+struct Stencil {
+  int r;
+  int w;
+  double c[3];
+  double b[3][7];
+  double alpha;
+  double lhs[3][3];
+
+  bool compact() const { return alpha != 0; }
+};
+
+static const Stencil EXPLICIT4_STENCIL = {
+  2, 5, {2.0/3, -1.0/12},
+  {{-25.0/12, 48.0/12, -36.0/12, 16.0/12, -3.0/12},
+   {-3.0/12, -10.0/12, 18.0/12, -6.0/12, 1.0/12}},
+  0, {{0, 1, 0}, {0, 1, 0}}
+};
+
+static const Stencil EXPLICIT6_STENCIL = {
+  3, 7, {3.0/4, -3.0/20, 1.0/60},
+  {{-147.0/60, 360.0/60, -450.0/60, 400.0/60, -225.0/60, 72.0/60, -10.0/60},
+   {-10.0/60, -77.0/60, 150.0/60, -100.0/60, 50.0/60, -15.0/60, 2.0/60},
+   {2.0/60, -24.0/60, -35.0/60, 80.0/60, -30.0/60, 8.0/60, -1.0/60}},
+  0, {{0, 1, 0}, {0, 1, 0}, {0, 1, 0}}
+};
+
+// f'_0 + 3 f'_1 = (-17/6 f_0 + 3/2 f_1 + 3/2 f_2 - 1/6 f_3) / h closes
+// both compact schemes with 4th order, COMPACT6 uses the COMPACT4 row on
+// the node next to it.
+static const Stencil COMPACT4_STENCIL = {
+  1, 4, {3.0/4},
+  {{-17.0/6, 3.0/2, 3.0/2, -1.0/6}},
+  1.0/4, {{0, 1, 3}}
+};
+
+static const Stencil COMPACT6_STENCIL = {
+  2, 4, {7.0/9, 1.0/36},
+  {{-17.0/6, 3.0/2, 3.0/2, -1.0/6},
+   {-3.0/4, 0, 3.0/4, 0}},
+  1.0/3, {{0, 1, 3}, {1.0/4, 1, 1.0/4}}
+};
+
+// nullptr for SECOND, which keeps the kernels above
+static const Stencil* stencil_of(const int scheme) {
+  switch (scheme) {
+    case 1: return &EXPLICIT4_STENCIL;
+    case 2: return &EXPLICIT6_STENCIL;
+    case 3: return &COMPACT4_STENCIL;
+    case 4: return &COMPACT6_STENCIL;
+    default: return nullptr;
+  }
+}
+
+static void check_line(const Stencil& s, const int n) {
+  if (n <= s.w || n < 8)
+    throw std::invalid_argument("grid is too small for the difference scheme");
+}
+
+// B f / h along one row
+template <int R, class T>
+static void stencil_row(const Stencil& s, const T* f, T* o, const int n, const T hinv) {
+  for (int k = 0; k < R; ++k) {
+    T lo = 0, hi = 0;
+    for (int m = 0; m < s.w; ++m) {
+      lo += (T)s.b[k][m] * f[m];
+      hi += (T)s.b[k][m] * f[n - 1 - m];
+    }
+    o[k] = lo * hinv;
+    o[n - 1 - k] = -hi * hinv;
+  }
+  T c[R];
+  for (int m = 0; m < R; ++m) c[m] = (T)s.c[m];
+  #pragma omp simd
+  for (int j = R; j < n - R; ++j) {
+    T a = 0;
+    for (int m = 1; m <= R; ++m) {
+      a += c[m-1] * (f[j+m] - f[j-m]);
+    }
+    o[j] = a * hinv;
+  }
+}
+
+// B f / h of grid row i, the stencil running down the columns
+template <class T>
+static void stencil_column_row(const Stencil& s, const T* in, T* o, const int i,
+                               const int rows, const int cols, const T hinv) {
+  std::fill(o, o + cols, (T)0);
+  if (i < s.r || i >= rows - s.r) {
+    const bool top = i < s.r;
+    const int k = top ? i : rows - 1 - i;
+    for (int m = 0; m < s.w; ++m) {
+      const T* f = in + (size_t)(top ? m : rows - 1 - m)*cols;
+      const T b = (T)(top ? s.b[k][m] : -s.b[k][m]);
+      #pragma omp simd
+      for (int j = 0; j < cols; ++j) {
+        o[j] += b * f[j];
+      }
+    }
+  } else {
+    for (int m = 1; m <= s.r; ++m) {
+      const T* up = in + (size_t)(i + m)*cols;
+      const T* down = in + (size_t)(i - m)*cols;
+      const T c = (T)s.c[m-1];
+      #pragma omp simd
+      for (int j = 0; j < cols; ++j) {
+        o[j] += c * (up[j] - down[j]);
+      }
+    }
+  }
+  #pragma omp simd
+  for (int j = 0; j < cols; ++j) {
+    o[j] *= hinv;
+  }
+}
+
+// A of a compact scheme for lines of n nodes
+static Tridiagonal line_matrix(const Stencil& s, const int n) {
+  std::vector<double> lower(n, s.alpha), diag(n, 1.0), upper(n, s.alpha);
+  for (int k = 0; k < s.r; ++k) {
+    lower[k] = s.lhs[k][0]; diag[k] = s.lhs[k][1]; upper[k] = s.lhs[k][2];
+    lower[n - 1 - k] = s.lhs[k][2]; diag[n - 1 - k] = s.lhs[k][1]; upper[n - 1 - k] = s.lhs[k][0];
+  }
+  return Tridiagonal(n, lower.data(), diag.data(), upper.data());
+}
+
+template <class T>
+static void diff_xi(const T* in, T* out, const int rows, const int cols, const T h,
+                    const Stencil* s=nullptr) {
+  if (!s) {
+    #pragma omp parallel for
+    for (int i = 0; i < rows; ++i) {
+      diff_xi_row(in + (size_t)i*cols, out + (size_t)i*cols, 0, cols, cols, h);
+    }
+    return;
+  }
+  check_line(*s, cols);
+  const T hinv = 1/h;
 
   #pragma omp parallel for
-  for (int i = 0; i < vals.getRows(); ++i) {
+  for (int i = 0; i < rows; ++i) {
+    const T* f = in + (size_t)i*cols;
+    T* o = out + (size_t)i*cols;
+    switch (s->r) {
+      case 1: stencil_row<1>(*s, f, o, cols, hinv); break;
+      case 2: stencil_row<2>(*s, f, o, cols, hinv); break;
+      default: stencil_row<3>(*s, f, o, cols, hinv); break;
+    }
+  }
+  if (s->compact()) {
+    line_matrix(*s, cols).solve_rows(out, rows, cols);
+  }
+}
+
+template <class T>
+static void diff_eta(const T* in, T* out, const int rows, const int cols, const T h,
+                     const Stencil* s=nullptr) {
+  if (!s) {
+    #pragma omp parallel for
+    for (int i = 0; i < rows; ++i) {
+      diff_eta_row(in + (size_t)i*cols, (long)cols, out + (size_t)i*cols, i, rows, cols, h);
+    }
+    return;
+  }
+  check_line(*s, rows);
+  const T hinv = 1/h;
+
+  #pragma omp parallel for
+  for (int i = 0; i < rows; ++i) {
+    stencil_column_row(*s, in, out + (size_t)i*cols, i, rows, cols, hinv);
+  }
+  if (s->compact()) {
+    line_matrix(*s, rows).solve_columns(out, cols, cols);
+  }
+}
+
+// Coordinate plane of the grid. Planar grids are differentiated in
+// place, other layouts are gathered into tmp first.
+static const double* plane(const Domain& grid, const bool x, std::vector<double>& tmp) {
+  if (grid.layout() == CoordStorage::PLANAR) {
+    return x ? grid.x_data() : grid.y_data();
+  }
+  tmp = x ? grid.getX() : grid.getY();
+  return tmp.data();
+}
+
+// out = jinv * (a*b - c*d) node by node, in one pass instead of a
+// temporary grid function per product. The field derivatives a and c are
+// of type T, the metric terms and all arithmetic are double.
+template <class T>
+static void combine_n(const double* jinv, const T* a, const double* b, const T* c,
+                      const double* d, T* out, const int n) {
+  #pragma omp simd
+  for (int k = 0; k < n; ++k) {
+    out[k] = (T)(jinv[k] * ((double)a[k] * b[k] - (double)c[k] * d[k]));
+  }
+}
+
+template <class T>
+static void combine(const double* jinv, const T* a, const double* b, const T* c,
+                    const double* d, T* out, const int rows, const int cols) {
+  #pragma omp parallel for
+  for (int i = 0; i < rows; ++i) {
+    const size_t o = (size_t)i*cols;
+    combine_n(jinv + o, a + o, b + o, c + o, d + o, out + o, cols);
+  }
+}
+
+// Metric terms on the nodes [i0, i1) x [j0, j1), stored row-major with
+// row length j1 - j0.
+struct Metrics {
+  std::vector<double> x_xi, x_eta, y_xi, y_eta, jinv;
+
+  explicit Metrics(const size_t n) : x_xi(n), x_eta(n), y_xi(n), y_eta(n), jinv(n) {}
+
+  void compute(const double* x, const double* y, const int rows, const int cols,
+               const int i0, const int i1, const int j0, const int j1) {
+    const int ld = j1 - j0;
+    const double hxi = 1.0 / (cols - 1), heta = 1.0 / (rows - 1);
+
+    for (int i = i0; i < i1; ++i) {
+      const size_t g = (size_t)i*cols + j0;
+      const size_t o = (size_t)(i - i0)*ld;
+      diff_xi_row(x + g, &x_xi[o], j0, j1, cols, hxi);
+      diff_eta_row(x + g, (long)cols, &x_eta[o], i, rows, ld, heta);
+      diff_xi_row(y + g, &y_xi[o], j0, j1, cols, hxi);
+      diff_eta_row(y + g, (long)cols, &y_eta[o], i, rows, ld, heta);
+      #pragma GCC ivdep
+      for (int j = 0; j < ld; ++j) {
+        jinv[o + j] = 1.0 / (x_xi[o + j]*y_eta[o + j] - x_eta[o + j]*y_xi[o + j] + 1e-8);
+      }
+    }
+  }
+};
+
+template <class T>
+BasicGFkt<T>::BasicGFkt(std::shared_ptr<Domain> _grid) : u(_grid->ysize()+1, _grid->xsize()+1),
+                                                         grid(_grid), tile(0),
+                                                         scheme(SECOND) { }
+template <class T>
+BasicGFkt<T>::BasicGFkt(const BasicGFkt& gf) : u(gf.u), grid(gf.grid), tile(gf.tile),
+                                                scheme(gf.scheme) { }
+
+template <class T>
+template <class U>
+BasicGFkt<T>::BasicGFkt(const BasicGFkt<U>& gf) : u(gf.u), grid(gf.grid), tile(gf.tile),
+                                                   scheme((Scheme)gf.scheme) { }
+
+template <class T>
+void BasicGFkt<T>::setTiling(const int _tile) {
+  if (_tile < 0)
+    throw std::invalid_argument("tile must be non-negative");
+  tile = _tile;
+}
+
+template <class T>
+void BasicGFkt<T>::setScheme(const Scheme _scheme) {
+  scheme = _scheme;
+}
+
+static Matrix jacobian_inverse(const Matrix& x_xi, const Matrix& x_eta,
+                               const Matrix& y_xi, const Matrix& y_eta) {
+  Matrix tmp(x_xi.getRows(), x_xi.getCols());
+
+  #pragma omp parallel for
+  for (int i = 0; i < (int)tmp.getRows(); ++i) {
     #pragma GCC ivdep
-    for (int j = 0; j < vals.getCols(); ++j) {
-      vals[i][j] = 1.0 / (vals[i][j] + 1e-8);
+    for (int j = 0; j < (int)tmp.getCols(); ++j) {
+      tmp[i][j] = 1.0 / (x_xi[i][j]*y_eta[i][j] - x_eta[i][j]*y_xi[i][j] + 1e-8);
     }
   }
-  tmp.set_values(vals); 
   return tmp;
 }
 
-GFkt& GFkt::operator=(const GFkt& gf) {
+template <class T>
+Matrix BasicGFkt<T>::detJinv() const {
+  return jacobian_inverse(dphix_dxi(), dphix_deta(), dphiy_dxi(), dphiy_deta());
+}
+
+template <class T>
+BasicGFkt<T>& BasicGFkt<T>::operator=(const BasicGFkt& gf) {
   if (this == &gf) {
     return *this;
   }
   u = gf.u;
   grid = gf.grid;
+  tile = gf.tile;
+  scheme = gf.scheme;
   return *this;
 }
 
-const GFkt& GFkt::operator+=(const GFkt& gf) {
+template <class T>
+const BasicGFkt<T>& BasicGFkt<T>::operator+=(const BasicGFkt& gf) {
   u += gf.u;
   return *this;
 }
 
-const GFkt GFkt::operator+(const GFkt& gf) const {
+template <class T>
+const BasicGFkt<T> BasicGFkt<T>::operator+(const BasicGFkt& gf) const {
   if (this->grid != gf.grid)
     throw std::invalid_argument("Addition of grid functions require identical grids.");
 
-  GFkt res(gf);
+  BasicGFkt res(gf);
   res.u = u + gf.u;
   return res;
 }
 
-const GFkt& GFkt::operator-=(const GFkt& gf) {
+template <class T>
+const BasicGFkt<T>& BasicGFkt<T>::operator-=(const BasicGFkt& gf) {
   u -= gf.u;
   return *this;
 }
 
-const GFkt GFkt::operator-(const GFkt& gf) const {
+template <class T>
+const BasicGFkt<T> BasicGFkt<T>::operator-(const BasicGFkt& gf) const {
   if (this->grid != gf.grid)
     throw std::invalid_argument("Addition of grid functions require identical grids.");
 
-  GFkt res(gf);
+  BasicGFkt res(gf);
   res.u = u - gf.u;
   return res;
 }
 
-const GFkt& GFkt::operator*=(const double k) {
+template <class T>
+const BasicGFkt<T>& BasicGFkt<T>::operator*=(const double k) {
   u *= k;
   return *this;
 }
 
-const GFkt GFkt::operator*(const GFkt& gf) const {
+template <class T>
+const BasicGFkt<T> BasicGFkt<T>::operator*(const BasicGFkt& gf) const {
 
   if (this->grid != gf.grid)
     throw std::invalid_argument("Addition of grid functions require identical grids.");
 
-  GFkt res(grid);
+  BasicGFkt res(grid);
 
   #pragma omp parallel for
   for (int i = 0; i < grid->ysize() + 1; ++i) {
-    #pragma GCC ivdep
+    T* r = res.u[i];
+    const T* a = u[i];
+    const T* b = gf.u[i];
+    #pragma omp simd
     for (int j = 0; j < grid->xsize() + 1; ++j) {
-      res.u[i][j] = u[i][j] * gf.u[i][j];
+      r[j] = a[j] * b[j];
     }
   }
   return res;
 }
 
-const GFkt GFkt::operator*(const double k) const {
-  GFkt res(*this);
+template <class T>
+const BasicGFkt<T> BasicGFkt<T>::operator*(const double k) const {
+  BasicGFkt res(*this);
   res *= k;
   return res;
 }
 
-const GFkt operator*(const double k, GFkt& gf) {
-  return gf * k;
-}
-
-const GFkt& GFkt::operator/=(const double k) {
+template <class T>
+const BasicGFkt<T>& BasicGFkt<T>::operator/=(const double k) {
   u /= k;
   return *this;
 }
 
-const GFkt GFkt::operator/(const double k) const {
-  GFkt res(*this);
+template <class T>
+const BasicGFkt<T> BasicGFkt<T>::operator/(const double k) const {
+  BasicGFkt res(*this);
   res /= k;
   return res; 
 }
 
-void GFkt::set_values(Matrix _u) {
+template <class T>
+void BasicGFkt<T>::set_values(BasicMatrix<T> _u) {
   u = _u;
 }
 
-void GFkt::set_values(double (*f)(double x, double y)) {
-  #pragma omp parallel for
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
-
-    for (int j = 0; j < grid->xsize() + 1; ++j) {
-      u[i][j] = f(grid->getPoint(i, j).x, grid->getPoint(i, j).y);
-    }
-  }
+template <class T>
+const double* BasicGFkt<T>::coordinates(const bool x, std::vector<double>& tmp) const {
+  return plane(*grid, x, tmp);
 }
 
-GFkt GFkt::dphix_dxi() const {
+template <class T>
+Matrix BasicGFkt<T>::dphix_dxi() const {
   // assume constant step size in xi
-  GFkt tmp(grid);
-  const double h = 1.0 / grid->xsize();
-
-  #pragma omp parallel for
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
+  Matrix tmp(grid->ysize() + 1, grid->xsize() + 1);
+  std::vector<double> buf;
+  diff_xi(plane(*grid, true, buf), tmp.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->xsize(),
+           stencil_of(scheme));
+  return tmp;
+}
 
-    tmp.u[i][0] =  (3*grid->getPoint(i, 0).x - 4*grid->getPoint(i, 1).x + grid->getPoint(i, 2).x) / (3 * h);
+template <class T>
+Matrix BasicGFkt<T>::dphiy_dxi() const {
+  // assume constant step size in xi
+  Matrix tmp(grid->ysize() + 1, grid->xsize() + 1);
+  std::vector<double> buf;
+  diff_xi(plane(*grid, false, buf), tmp.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->xsize(),
+           stencil_of(scheme));
+  return tmp;
+}
 
-    for (int j = 1; j < grid->xsize(); ++j) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i, j+1).x - grid->getPoint(i, j-1).x);
-    }
+template <class T>
+Matrix BasicGFkt<T>::dphix_deta() const {
+  // assume constant step size in eta
+  Matrix tmp(grid->ysize() + 1, grid->xsize() + 1);
+  std::vector<double> buf;
+  diff_eta(plane(*grid, true, buf), tmp.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->ysize(),
+           stencil_of(scheme));
+  return tmp;
+}
 
-    tmp.u[i][grid->xsize()] = (3*grid->getPoint(i, grid->xsize()).x
-                              -4*grid->getPoint(i, grid->xsize() - 1).x
-                              +  grid->getPoint(i, grid->xsize() - 2).x) / (3 * h);
-  }
+template <class T>
+Matrix BasicGFkt<T>::dphiy_deta() const {
+  // assume constant step size in eta
+  Matrix tmp(grid->ysize() + 1, grid->xsize() + 1);
+  std::vector<double> buf;
+  diff_eta(plane(*grid, false, buf), tmp.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->ysize(),
+           stencil_of(scheme));
   return tmp;
 }
 
-GFkt GFkt::dphiy_dxi() const {
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::du_dxi() const {
   // assume constant step size in xi
-  GFkt tmp(grid);
-  const double h = 1.0 / grid->xsize();
+  BasicGFkt tmp(grid);
+  diff_xi(u.getArray(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, (T)(1.0 / grid->xsize()),
+          stencil_of(scheme));
+  return tmp;
+}
 
-  #pragma omp parallel for
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::du_deta() const {
+  // assume constant step size in eta
+  BasicGFkt tmp(grid);
+  diff_eta(u.getArray(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, (T)(1.0 / grid->ysize()),
+           stencil_of(scheme));
+  return tmp;
+}
 
-    tmp.u[i][0] =  (3*grid->getPoint(i, 0).y - 4*grid->getPoint(i, 1).y + grid->getPoint(i, 2).y) / (3 * h);
-    for (int j = 1; j < grid->xsize(); ++j) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i, j+1).y - grid->getPoint(i, j-1).y);
-    }
-    
-    tmp.u[i][grid->xsize()] = (3*grid->getPoint(i, grid->xsize()).y
-                              -4*grid->getPoint(i, grid->xsize() - 1).y
-                              +  grid->getPoint(i, grid->xsize() - 2).y) / (3 * h);
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::du_dx() const {
+  if (grid->xsize() < 2 || grid->ysize() < 2) {
+    exit(-1);
   }
+  if (tile > 0 && scheme == SECOND) {
+    return tiled(DX, 1, 0.0);
+  }
+  BasicGFkt tmp(grid);
+  tmp.scheme = scheme;
+  combine(detJinv().getArray(), du_dxi().u.getArray(), dphiy_deta().getArray(),
+          du_deta().u.getArray(), dphiy_dxi().getArray(), tmp.u.getArray(),
+          grid->ysize() + 1, grid->xsize() + 1);
   return tmp;
 }
 
-GFkt GFkt::dphix_deta() const {
-  // assume constant step size in eta
-  GFkt tmp(grid);
-  const double h = 1.0 / grid->ysize();
-
-  #pragma omp parallel for
-  for (int j = 0; j < grid->xsize() + 1; ++j) {
-    
-    tmp.u[0][j] =  (3*grid->getPoint(0, j).x - 4*grid->getPoint(1, j).x + grid->getPoint(2, j).x) / (3 * h);
-    for (int i = 1; i < grid->ysize(); ++i) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i+1, j).x - grid->getPoint(i-1, j).x);
-    }
-    
-    tmp.u[grid->ysize()][j] = (3*grid->getPoint(grid->ysize(), j).x
-                              -4*grid->getPoint(grid->ysize() - 1, j).x
-                              +  grid->getPoint(grid->ysize() - 2, j).x) / (3 * h);
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::du_dy() const {
+  if (grid->xsize() < 2 || grid->ysize() < 2) {
+    exit(-1);
   }
+  if (tile > 0 && scheme == SECOND) {
+    return tiled(DY, 1, 0.0);
+  }
+  BasicGFkt tmp(grid);
+  tmp.scheme = scheme;
+  combine(detJinv().getArray(), du_deta().u.getArray(), dphix_dxi().getArray(),
+          du_dxi().u.getArray(), dphix_deta().getArray(), tmp.u.getArray(),
+          grid->ysize() + 1, grid->xsize() + 1);
   return tmp;
 }
 
-GFkt GFkt::dphiy_deta() const {
-  // assume constant step size in eta
-  GFkt tmp(grid);
-  const double h = 1.0 / grid->ysize();
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::Laplace() const {
+  // du/dx and du/dy of the shared pass are differentiated again in cache
+  // instead of going through du_dx() and du_dy() of whole grids
+  Derivatives d(*this);
+  return d[LAPLACE];
+}
 
-  #pragma omp parallel for
-  for (int j = 0; j < grid->xsize() + 1; ++j) {
-    
-    tmp.u[0][j] =  (3*grid->getPoint(0, j).y - 4*grid->getPoint(1, j).y + grid->getPoint(2, j).y) / (3 * h);
-    for (int i = 1; i < grid->ysize(); ++i) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i+1, j).y - grid->getPoint(i-1, j).y);
+// Overlapped temporal blocking of k applications of op, each one optionally
+// an explicit Euler step u + dt*op(u). Every thread copies the tile plus a
+// halo of k times the operator reach into small buffers and applies the
+// operator k times there, the valid part shrinking by the reach per step,
+// so the grid is read and written once for all k steps. The metric terms
+// are computed once per tile for all steps. The Laplacian computes the
+// first derivatives on the step's block plus the stencil reach of two nodes
+// and differentiates them again without going back to memory. Same
+// arithmetic as the whole grid operators, so the results are identical.
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::tiled(const Operator op, const int k, const double dt) const {
+  const int rows = grid->ysize() + 1, cols = grid->xsize() + 1;
+  const T hxi = (T)(1.0 / grid->xsize()), heta = (T)(1.0 / grid->ysize());
+  std::vector<double> xbuf, ybuf;
+  const double* x = plane(*grid, true, xbuf);
+  const double* y = plane(*grid, false, ybuf);
+  const T* in = u.getArray();
+
+  // nodes one application reads away from the node it computes
+  const int reach = (op == LAPLACE) ? 4 : 2;
+  const GridTiles tiles(rows, cols, tile, k * reach);
+  const size_t hsize = (size_t)tiles.max_halo_rows() * tiles.max_halo_cols();
+
+  BasicGFkt res(grid);
+  res.tile = tile;
+  T* out = res.u.getArray();
+
+  #pragma omp parallel
+  {
+    Metrics m(hsize);
+    std::vector<T> cur(hsize), next(hsize), u_xi(hsize), u_eta(hsize);
+    std::vector<T> ux(hsize), uy(hsize), d_xi(hsize), d_eta(hsize), uxx(hsize), uyy(hsize);
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < tiles.size(); ++t) {
+      const Tile b = tiles[t];
+      const int ld = b.halo_cols();
+      m.compute(x, y, rows, cols, b.hi0, b.hi1, b.hj0, b.hj1);
+      for (int i = b.hi0; i < b.hi1; ++i) {
+        std::copy(in + (size_t)i*cols + b.hj0, in + (size_t)i*cols + b.hj1,
+                  &cur[(size_t)(i - b.hi0)*ld]);
+      }
+
+      for (int s = 1; s <= k; ++s) {
+        // nodes still valid after this step
+        const Tile r = GridTiles(rows, cols, tile, (k - s) * reach)[t];
+
+        if (op == LAPLACE) {
+          // First derivatives on the block plus two nodes
+          const int i0 = std::max(r.hi0 - 2, 0), i1 = std::min(r.hi1 + 2, rows);
+          const int j0 = std::max(r.hj0 - 2, 0), j1 = std::min(r.hj1 + 2, cols);
+          for (int i = i0; i < i1; ++i) {
+            const size_t o = (size_t)(i - b.hi0)*ld + (j0 - b.hj0);
+            diff_xi_row(&cur[o], &u_xi[o], j0, j1, cols, hxi);
+            diff_eta_row(&cur[o], (long)ld, &u_eta[o], i, rows, j1 - j0, heta);
+            combine_n(&m.jinv[o], &u_xi[o], &m.y_eta[o], &u_eta[o], &m.y_xi[o], &ux[o], j1 - j0);
+            combine_n(&m.jinv[o], &u_eta[o], &m.x_xi[o], &u_xi[o], &m.x_eta[o], &uy[o], j1 - j0);
+          }
+        }
+
+        const int n = r.halo_cols();
+        for (int i = r.hi0; i < r.hi1; ++i) {
+          const size_t o = (size_t)(i - b.hi0)*ld + (r.hj0 - b.hj0);
+          const T* lo = &uxx[o];
+
+          if (op == LAPLACE) {
+            diff_xi_row(&ux[o], &d_xi[o], r.hj0, r.hj1, cols, hxi);
+            diff_eta_row(&ux[o], (long)ld, &d_eta[o], i, rows, n, heta);
+            combine_n(&m.jinv[o], &d_xi[o], &m.y_eta[o], &d_eta[o], &m.y_xi[o], &uxx[o], n);
+
+            diff_xi_row(&uy[o], &d_xi[o], r.hj0, r.hj1, cols, hxi);
+            diff_eta_row(&uy[o], (long)ld, &d_eta[o], i, rows, n, heta);
+            combine_n(&m.jinv[o], &d_eta[o], &m.x_xi[o], &d_xi[o], &m.x_eta[o], &uyy[o], n);
+
+            #pragma omp simd
+            for (int j = 0; j < n; ++j) {
+              uxx[o + j] = uxx[o + j] + uyy[o + j];
+            }
+          } else {
+            diff_xi_row(&cur[o], &u_xi[o], r.hj0, r.hj1, cols, hxi);
+            diff_eta_row(&cur[o], (long)ld, &u_eta[o], i, rows, n, heta);
+            if (op == DX) {
+              combine_n(&m.jinv[o], &u_xi[o], &m.y_eta[o], &u_eta[o], &m.y_xi[o], &uxx[o], n);
+            } else {
+              combine_n(&m.jinv[o], &u_eta[o], &m.x_xi[o], &u_xi[o], &m.x_eta[o], &uxx[o], n);
+            }
+          }
+
+          if (dt == 0.0) {
+            std::copy(lo, lo + n, &next[o]);
+          } else {
+            const T step = (T)dt;
+            #pragma omp simd
+            for (int j = 0; j < n; ++j) {
+              next[o + j] = cur[o + j] + lo[j] * step;
+            }
+          }
+        }
+        cur.swap(next);
+      }
+
+      for (int i = b.i0; i < b.i1; ++i) {
+        const size_t o = (size_t)(i - b.hi0)*ld + (b.j0 - b.hj0);
+        std::copy(&cur[o], &cur[o] + b.cols(), out + (size_t)i*cols + b.j0);
+      }
     }
-    
-    tmp.u[grid->ysize()][j] = (3*grid->getPoint(grid->ysize(), j).y
-                          -4*grid->getPoint(grid->ysize() - 1, j).y
-                          +  grid->getPoint(grid->ysize() - 2, j).y) / (3 * h);
   }
-  return tmp;
+  return res;
 }
 
+// One pass over the grid for any of du_dx, du_dy and Laplace. Every tile
+// computes the metric terms on its block plus the halo once, u_xi and
+// u_eta once, and du/dx and du/dy once, as results and, on the block
+// plus the two nodes the stencils reach, as input of the Laplacian. u is
+// read in place, so the halo is only needed for the metric terms. Without
+// tiling the pass still goes tile by tile, which gives the same results.
+// The higher order schemes share the same terms on whole grids instead.
+template <class T>
+void BasicGFkt<T>::evaluate(const bool* want, BasicGFkt* const* out) const {
+  if (grid->xsize() < 2 || grid->ysize() < 2) {
+    exit(-1);
+  }
+  const bool lap = want[LAPLACE];
+  const bool need_x = want[DX] || lap, need_y = want[DY] || lap;
+  const int rows = grid->ysize() + 1, cols = grid->xsize() + 1;
+
+  if (scheme != SECOND) {
+    const Matrix x_xi = dphix_dxi(), x_eta = dphix_deta();
+    const Matrix y_xi = dphiy_dxi(), y_eta = dphiy_deta();
+    const Matrix jinv = jacobian_inverse(x_xi, x_eta, y_xi, y_eta);
+    const BasicGFkt u_xi = du_dxi(), u_eta = du_deta();
+    BasicGFkt ux(*this), uy(*this);
+    if (need_x) {
+      combine(jinv.getArray(), u_xi.u.getArray(), y_eta.getArray(), u_eta.u.getArray(),
+              y_xi.getArray(), ux.u.getArray(), rows, cols);
+    }
+    if (need_y) {
+      combine(jinv.getArray(), u_eta.u.getArray(), x_xi.getArray(), u_xi.u.getArray(),
+              x_eta.getArray(), uy.u.getArray(), rows, cols);
+    }
+    if (lap) {
+      BasicGFkt uxx(*this), uyy(*this);
+      combine(jinv.getArray(), ux.du_dxi().u.getArray(), y_eta.getArray(),
+              ux.du_deta().u.getArray(), y_xi.getArray(), uxx.u.getArray(), rows, cols);
+      combine(jinv.getArray(), uy.du_deta().u.getArray(), x_xi.getArray(),
+              uy.du_dxi().u.getArray(), x_eta.getArray(), uyy.u.getArray(), rows, cols);
+      out[LAPLACE]->u = uxx.u + uyy.u;
+    }
+    if (want[DX]) {
+      out[DX]->u = ux.u;
+    }
+    if (want[DY]) {
+      out[DY]->u = uy.u;
+    }
+    return;
+  }
 
-GFkt GFkt::du_dxi() const {
-  // assume constant step size in xi
-  GFkt tmp(grid);
-  const double h = 1.0 / grid->xsize();
-
-  #pragma omp parallel for
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
-    
-    tmp.u[i][0] = (3*u[i][0] - 4*u[i][1] + u[i][2]) / (3 * h);
-    for (int j = 1; j < grid->xsize(); ++j) {
-      tmp.u[i][j] = (1/(2*h)) * (u[i][j+1] - u[i][j-1]);
+  const T hxi = (T)(1.0 / grid->xsize()), heta = (T)(1.0 / grid->ysize());
+  std::vector<double> xbuf, ybuf;
+  const double* x = plane(*grid, true, xbuf);
+  const double* y = plane(*grid, false, ybuf);
+  const T* in = u.getArray();
+
+  T* dx = want[DX] ? out[DX]->u.getArray() : nullptr;
+  T* dy = want[DY] ? out[DY]->u.getArray() : nullptr;
+  T* dd = lap ? out[LAPLACE]->u.getArray() : nullptr;
+
+  const int grow = lap ? 2 : 0;
+  const GridTiles tiles(rows, cols, tile > 0 ? tile : 64, grow);
+  const size_t hsize = (size_t)tiles.max_halo_rows() * tiles.max_halo_cols();
+
+  #pragma omp parallel
+  {
+    Metrics m(hsize);
+    std::vector<T> u_xi(hsize), u_eta(hsize), ux(hsize), uy(hsize);
+    std::vector<T> d_xi(hsize), d_eta(hsize), uxx(hsize), uyy(hsize);
+
+    #pragma omp for schedule(dynamic)
+    for (int t = 0; t < tiles.size(); ++t) {
+      const Tile b = tiles[t];
+      const int ld = b.halo_cols();
+      m.compute(x, y, rows, cols, b.hi0, b.hi1, b.hj0, b.hj1);
+
+      // shared first derivatives on the halo block
+      const int n = b.halo_cols();
+      for (int i = b.hi0; i < b.hi1; ++i) {
+        const size_t o = (size_t)(i - b.hi0)*ld;
+        const T* r = in + (size_t)i*cols + b.hj0;
+        diff_xi_row(r, &u_xi[o], b.hj0, b.hj1, cols, hxi);
+        diff_eta_row(r, (long)cols, &u_eta[o], i, rows, n, heta);
+        if (need_x) {
+          combine_n(&m.jinv[o], &u_xi[o], &m.y_eta[o], &u_eta[o], &m.y_xi[o], &ux[o], n);
+        }
+        if (need_y) {
+          combine_n(&m.jinv[o], &u_eta[o], &m.x_xi[o], &u_xi[o], &m.x_eta[o], &uy[o], n);
+        }
+      }
+
+      const int bn = b.cols();
+      for (int i = b.i0; i < b.i1; ++i) {
+        const size_t o = (size_t)(i - b.hi0)*ld + (b.j0 - b.hj0);
+        const size_t g = (size_t)i*cols + b.j0;
+        if (dx) {
+          std::copy(&ux[o], &ux[o] + bn, dx + g);
+        }
+        if (dy) {
+          std::copy(&uy[o], &uy[o] + bn, dy + g);
+        }
+        if (dd) {
+          diff_xi_row(&ux[o], &d_xi[o], b.j0, b.j1, cols, hxi);
+          diff_eta_row(&ux[o], (long)ld, &d_eta[o], i, rows, bn, heta);
+          combine_n(&m.jinv[o], &d_xi[o], &m.y_eta[o], &d_eta[o], &m.y_xi[o], &uxx[o], bn);
+
+          diff_xi_row(&uy[o], &d_xi[o], b.j0, b.j1, cols, hxi);
+          diff_eta_row(&uy[o], (long)ld, &d_eta[o], i, rows, bn, heta);
+          combine_n(&m.jinv[o], &d_eta[o], &m.x_xi[o], &d_xi[o], &m.x_eta[o], &uyy[o], bn);
+
+          T* r = dd + g;
+          #pragma omp simd
+          for (int j = 0; j < bn; ++j) {
+            r[j] = uxx[o + j] + uyy[o + j];
+          }
+        }
+      }
     }
-    
-    tmp.u[i][grid->xsize()] = (3*u[i][grid->xsize()]
-                              - 4*u[i][grid->xsize() - 1]
-                              + u[i][grid->xsize() - 2]) / (3 * h);
   }
-  return tmp;
 }
 
-GFkt GFkt::du_deta() const {
-  // assume constant step size in eta
-  GFkt tmp(grid);
-  const double h = 1.0 / grid->ysize();
+template <class T>
+BasicGFkt<T>::Derivatives::Derivatives(const BasicGFkt& f) : f(f), wanted{false, false, false} { }
 
-  #pragma omp parallel for
-  for (int j = 0; j < grid->xsize() + 1; ++j) {
-    
-    tmp.u[0][j] = (3*u[0][j] - 4*u[1][j] + u[2][j]) / (3 * h);
+template <class T>
+typename BasicGFkt<T>::Derivatives& BasicGFkt<T>::Derivatives::request(const Operator op) {
+  wanted[op] = true;
+  return *this;
+}
 
-    for (int i = 1; i < grid->ysize(); ++i) {
-      tmp.u[i][j] = (1/(2*h)) * (u[i+1][j] - u[i-1][j]);
+template <class T>
+void BasicGFkt<T>::Derivatives::evaluate() {
+  bool want[3];
+  BasicGFkt* out[3];
+  bool any = false;
+  for (int op = 0; op < 3; ++op) {
+    want[op] = wanted[op] && !result[op];
+    if (want[op]) {
+      result[op].reset(new BasicGFkt(f.grid));
+      result[op]->tile = f.tile;
+      result[op]->scheme = f.scheme;
+      any = true;
     }
-    
-    tmp.u[grid->ysize()][j] = (3*u[grid->ysize()][j]
-                              - 4*u[grid->ysize() - 1][j]
-                              + u[grid->ysize() - 2][j]) / (3 * h);
+    out[op] = result[op].get();
+  }
+  if (any) {
+    f.evaluate(want, out);
   }
-  return tmp;
 }
 
-GFkt GFkt::du_dx() const {
-  if (grid->xsize() < 2 || grid->ysize() < 2) {
-    exit(-1);
+template <class T>
+const BasicGFkt<T>& BasicGFkt<T>::Derivatives::operator[](const Operator op) {
+  if (!result[op]) {
+    request(op);
+    evaluate();
   }
-  GFkt tmp = detJinv() * (du_dxi() * dphiy_deta() - du_deta() * dphiy_dxi());
-  return tmp;
+  return *result[op];
 }
 
-GFkt GFkt::du_dy() const {
+template <class T>
+BasicGFkt<T> BasicGFkt<T>::iterate(const Operator op, const int k, const double dt) const {
+  if (k < 0) {
+    throw std::invalid_argument("number of applications must be non-negative");
+  }
   if (grid->xsize() < 2 || grid->ysize() < 2) {
     exit(-1);
   }
-  GFkt tmp = detJinv() * (du_deta() * dphix_dxi() - du_dxi() * dphix_deta());
-  return tmp;
-}
+  if (tile > 0 && k > 0 && scheme == SECOND) {
+    return tiled(op, k, dt);
+  }
 
-GFkt GFkt::Laplace() const {
-  GFkt ddxx = (this->du_dx()).du_dx();
-  GFkt ddyy = (this->du_dy()).du_dy();
-  return ddxx + ddyy;  
+  BasicGFkt v(*this);
+  for (int s = 0; s < k; ++s) {
+    const BasicGFkt w = (op == DX) ? v.du_dx() : (op == DY) ? v.du_dy() : v.Laplace();
+    if (dt == 0.0) {
+      v = w;
+    } else {
+      v += w * dt;
+    }
+  }
+  return v;
 }
 
-Matrix GFkt::get_values() const {
+template <class T>
+BasicMatrix<T> BasicGFkt<T>::get_values() const {
   return this->u;
 }
 
-void GFkt::toFile(const char* filename) const {
+template <class T>
+void BasicGFkt<T>::toFile(const char* filename) const {
   std::ofstream ofile;
   std::cout << "hello: " << filename << std::endl;
   ofile.open(filename);
@@ -282,10 +861,37 @@ void GFkt::toFile(const char* filename) const {
   ofile << grid->xsize() << "\n";
   const std::vector<double> xvals = grid->getX();
   const std::vector<double> yvals = grid->getY();
-  const double* zvals = u.getArray();
+  const T* zvals = u.getArray();
   for (int i = 0; i < (grid->ysize() + 1)*(grid->xsize() + 1); ++i) {
     ofile << xvals[i] << ", ";
     ofile << yvals[i] << ", ";
     ofile << zvals[i] << "\n";
   }
 }
+
+template <class T>
+void BasicGFkt<T>::toFile(const char* filename, const char* gridfile,
+                          const FieldFile::Codec codec, const double tolerance) const {
+  FieldFile::write(filename, gridfile, u.getArray(), u.getRows(), u.getCols(), codec, tolerance);
+}
+
+template <class T>
+void BasicGFkt<T>::toFile(const char* filename, const char* gridfile, AsyncWriter& writer,
+                          const FieldFile::Codec codec, const double tolerance) const {
+  const std::shared_ptr<const BasicMatrix<T> > snapshot = std::make_shared<const BasicMatrix<T> >(u);
+  const std::string name(filename), grid_name(gridfile);
+  writer.submit([snapshot, name, grid_name, codec, tolerance] {
+    FieldFile::write(name.c_str(), grid_name.c_str(), snapshot->getArray(),
+                     snapshot->getRows(), snapshot->getCols(), codec, tolerance);
+  });
+}
+
+template <class T>
+void BasicGFkt<T>::toFile(DatasetWriter& out, const char* name) const {
+  out.add(name, u);
+}
+
+template class BasicGFkt<double>;
+template class BasicGFkt<float>;
+template BasicGFkt<double>::BasicGFkt(const BasicGFkt<float>&);
+template BasicGFkt<float>::BasicGFkt(const BasicGFkt<double>&);
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <memory>
 #include <cmath>
+#include <omp.h>
+#include <unistd.h>
 
 #include "Curvebase.hpp"
 #include "Line.hpp"
@@ -19,19 +21,96 @@ double u(double x, double y) {
   return std::sin(pow(x/10, 2))*cos(x/10) + y;
 }
 
-int main(int argc, char const *argv[])
+// exact du/dx, for the error of the difference schemes
+double dudx(double x, double /*y*/) {
+  return std::cos(pow(x/10, 2))*x/50*cos(x/10) - std::sin(pow(x/10, 2))*sin(x/10)/10;
+}
+
+// du/dx of the second order scheme node by node, straight from the
+// formulas, to check the row kernels of GFkt against
+Matrix reference_du_dx(const Domain& grid, const Matrix& v) {
+  const int rows = grid.ysize() + 1, cols = grid.xsize() + 1;
+  const double hxi = 1.0 / grid.xsize(), heta = 1.0 / grid.ysize();
+  Matrix x(rows, cols), y(rows, cols), res(rows, cols);
+  for (int i = 0; i < rows; ++i)
+    for (int j = 0; j < cols; ++j){
+      x[i][j] = grid.getX(i, j);
+      y[i][j] = grid.getY(i, j);
+    }
+
+  // d/dxi and d/deta of f at node (i, j)
+  auto dxi = [&](const Matrix& f, int i, int j){
+    if (j == 0) return -(3*f[i][0] - 4*f[i][1] + f[i][2]) / (2*hxi);
+    if (j == cols - 1) return (3*f[i][j] - 4*f[i][j-1] + f[i][j-2]) / (2*hxi);
+    return (f[i][j+1] - f[i][j-1]) / (2*hxi);
+  };
+  auto deta = [&](const Matrix& f, int i, int j){
+    if (i == 0) return -(3*f[0][j] - 4*f[1][j] + f[2][j]) / (2*heta);
+    if (i == rows - 1) return (3*f[i][j] - 4*f[i-1][j] + f[i-2][j]) / (2*heta);
+    return (f[i+1][j] - f[i-1][j]) / (2*heta);
+  };
+
+  for (int i = 0; i < rows; ++i)
+    for (int j = 0; j < cols; ++j){
+      const double x_xi = dxi(x, i, j), x_eta = deta(x, i, j);
+      const double y_xi = dxi(y, i, j), y_eta = deta(y, i, j);
+      // det J with the same guard against 0 as GFkt
+      res[i][j] = (dxi(v, i, j)*y_eta - deta(v, i, j)*y_xi) / (x_xi*y_eta - x_eta*y_xi + 1e-8);
+    }
+  return res;
+}
+
+int main(int argc, char *argv[])
 {
 
   int m = 50; int n = 20;
   // int m = 10; int n = 6;
   double delta = 0.0;
+  int reps = 0;
+  int layout = CoordStorage::PLANAR;
+  int tile = 0;
+  int steps = 0;
+  int codec = FieldFile::RAW;
+  int snap = 0;
+  double tolerance = 1e-6;
+  int scheme = GFkt::SECOND;
 
-  if (argc > 2){
-    m = atoi(argv[1]);
-    n = atoi(argv[2]);
+  // Optional benchmarks and settings as flags, the grid as before:
+  //   main [flags] [m n [delta]]
+  //   -r reps    time du_dx and Laplace in double and in float this many times
+  //   -l layout  coordinate storage of the grid, 0: planar, 1: interleaved, 2: tiled
+  //   -t tile    tile edge for du_dx, du_dy and Laplace, 0 works on the whole grid
+  //   -s steps   time this many Laplacian smoothing steps, naive against tiled
+  //   -c codec   0: raw results, 1: deflate, 2: lossless predictive float coding,
+  //              3: quantized within tolerance
+  //   -w snap    with -s, also time writing the field every snap steps,
+  //              blocking against on a background writer
+  //   -e tol     largest error of the quantized codec
+  //   -d scheme  0: second order, 1, 2: explicit 4th, 6th order,
+  //              3, 4: compact 4th, 6th order
+  int opt;
+  while ((opt = getopt(argc, argv, "r:l:t:s:c:w:e:d:")) != -1){
+    switch (opt){
+    case 'r': reps = atoi(optarg); break;
+    case 'l': layout = atoi(optarg); break;
+    case 't': tile = atoi(optarg); break;
+    case 's': steps = atoi(optarg); break;
+    case 'c': codec = atoi(optarg); break;
+    case 'w': snap = atoi(optarg); break;
+    case 'e': tolerance = atof(optarg); break;
+    case 'd': scheme = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-r reps] [-l layout] [-t tile] [-s steps] [-c codec]"
+              " [-w snap] [-e tol] [-d scheme] [m n [delta]]\n", argv[0]);
+      return 1;
+    }
   }
-  if (argc > 3){
-    delta = atof(argv[3]);
+  if (argc - optind > 1){
+    m = atoi(argv[optind]);
+    n = atoi(argv[optind + 1]);
+  }
+  if (argc - optind > 2){
+    delta = atof(argv[optind + 2]);
   }
 
   printf("Generating %dx%d grid\n", m, n);
@@ -50,6 +129,7 @@ int main(int argc, char const *argv[])
   Domain myDomain = Domain(top, left, bottom, right);
   // Domain myDomain = Domain(top, right, bottom, left); // if all curves are reversed
   
+  myDomain.setLayout((CoordStorage::Layout)layout);
   myDomain.generate_grid(m, n, delta);
 
   // myDomain.toFile(file);
@@ -69,16 +149,150 @@ int main(int argc, char const *argv[])
   // GFkt divide = myGFkt_1 / 5.0;
   
   myGFkt_1.set_values(u);
+  myGFkt_1.setTiling(tile);
+  myGFkt_1.setScheme((GFkt::Scheme)scheme);
   // myGFkt_1.get_values().print();
-  GFkt xder = myGFkt_1.du_dx();
-  GFkt yder = myGFkt_1.du_dy();
-  GFkt Lapl = myGFkt_1.Laplace();
+  // all three derivatives in one pass that shares the metric terms
+  GFkt::Derivatives derivs(myGFkt_1);
+  derivs.request(GFkt::DX).request(GFkt::DY).request(GFkt::LAPLACE).evaluate();
+  GFkt xder = derivs[GFkt::DX];
+  GFkt yder = derivs[GFkt::DY];
+  GFkt Lapl = derivs[GFkt::LAPLACE];
+
+  {
+    GFkt exact(myGFkt_1);
+    exact.set_values(dudx);
+    const Matrix err = (xder - exact).get_values();
+    double largest = 0;
+    for (unsigned i = 0; i < err.getRows(); ++i)
+      for (unsigned j = 0; j < err.getCols(); ++j)
+        largest = max(largest, fabs(err[i][j]));
+    printf("max error of du_dx: %.3e\n", largest);
+  }
+  if (scheme == GFkt::SECOND){
+    // the row kernels, tiled or not, against the formulas node by node
+    const Matrix diff = xder.get_values() - reference_du_dx(myDomain, myGFkt_1.get_values());
+    double largest = 0;
+    for (unsigned i = 0; i < diff.getRows(); ++i)
+      for (unsigned j = 0; j < diff.getCols(); ++j)
+        largest = max(largest, fabs(diff[i][j]));
+    printf("max difference to node by node du_dx: %.3e\n", largest);
+  }
   // Lapl.get_values().print();
 
-  myGFkt_1.toFile("u.txt");
-  xder.toFile("xder.txt");
-  yder.toFile("yder.txt");
-  Lapl.toFile("Laplace.txt");
+  // The grid once and all fields in one file
+  {
+    double t0 = omp_get_wtime();
+    DatasetWriter results("results.gfd", (FieldFile::Codec)codec, tolerance);
+    results.add(myDomain);
+    myGFkt_1.toFile(results, "u");
+    xder.toFile(results, "xder");
+    yder.toFile(results, "yder");
+    Lapl.toFile(results, "Laplace");
+    results.close();
+    double t1 = omp_get_wtime();
+
+    double raw = 0, stored = 0;
+    const DatasetReader check("results.gfd");
+    for (size_t e = 0; e < check.entries().size(); ++e){
+      const DatasetEntry& entry = check.entries()[e];
+      raw += (double)entry.rows * entry.cols * entry.value_bytes;
+      for (size_t c = 0; c < entry.sizes.size(); ++c) stored += entry.sizes[c];
+    }
+    printf("results.gfd: %.1f MB in %.4f s, %.0f MB/s, ratio %.2f\n",
+           stored * 1e-6, t1 - t0, raw * 1e-6 / (t1 - t0), raw / stored);
+  }
+
+  if (reps > 0){
+    const FGFkt myFGFkt = FGFkt(myGFkt_1);
+    double t0 = omp_get_wtime();
+    for (int r = 0; r < reps; ++r) xder = myGFkt_1.du_dx();
+    double t1 = omp_get_wtime();
+    for (int r = 0; r < reps; ++r) Lapl = myGFkt_1.Laplace();
+    double t2 = omp_get_wtime();
+    FGFkt fxder = myFGFkt.du_dx();
+    for (int r = 0; r < reps; ++r) fxder = myFGFkt.du_dx();
+    double t3 = omp_get_wtime();
+    FGFkt fLapl = myFGFkt.Laplace();
+    for (int r = 0; r < reps; ++r) fLapl = myFGFkt.Laplace();
+    double t4 = omp_get_wtime();
+
+    // du_dx, du_dy and Laplace one at a time against one shared pass
+    for (int r = 0; r < reps; ++r){
+      xder = myGFkt_1.du_dx();
+      yder = myGFkt_1.du_dy();
+      Lapl = myGFkt_1.Laplace();
+    }
+    double t5 = omp_get_wtime();
+    for (int r = 0; r < reps; ++r){
+      GFkt::Derivatives d(myGFkt_1);
+      d.request(GFkt::DX).request(GFkt::DY).request(GFkt::LAPLACE).evaluate();
+      xder = d[GFkt::DX];
+      yder = d[GFkt::DY];
+      Lapl = d[GFkt::LAPLACE];
+    }
+    double t6 = omp_get_wtime();
+
+    const double err = (Matrix(fxder.get_values()) - xder.get_values()).norm() / xder.get_values().norm();
+    printf("%-8s %12s %12s\n", "", "du_dx [s]", "Laplace [s]");
+    printf("%-8s %12.6f %12.6f\n", "double", (t1 - t0) / reps, (t2 - t1) / reps);
+    printf("%-8s %12.6f %12.6f\n", "float", (t3 - t2) / reps, (t4 - t3) / reps);
+    printf("du_dx, du_dy, Laplace: %.6f s separately, %.6f s shared\n",
+           (t5 - t4) / reps, (t6 - t5) / reps);
+    printf("relative l2 difference of du_dx: %.3e\n", err);
+  }
+
+  if (steps > 0){
+    // Explicit heat equation steps, stable for dt below h^2/4 in the
+    // parameter plane, that is far below the physical grid spacing.
+    const double dt = 1e-3 / ((double)m * m + (double)n * n);
+    GFkt naive(myGFkt_1);
+    naive.setTiling(0);
+    GFkt blocked(myGFkt_1);
+    blocked.setTiling(tile > 0 ? tile : 64);
+
+    double t0 = omp_get_wtime();
+    const GFkt a = naive.iterate(GFkt::LAPLACE, steps, dt);
+    double t1 = omp_get_wtime();
+    const GFkt b = blocked.iterate(GFkt::LAPLACE, steps, dt);
+    double t2 = omp_get_wtime();
+
+    // the least traffic of one step is reading and writing u once
+    const double bytes = 2.0 * sizeof(double) * (m + 1) * (n + 1) * steps;
+    printf("%d Laplacian steps  %10s %12s\n", steps, "time [s]", "GB/s of u");
+    printf("%-18s %10.4f %12.2f\n", "naive", t1 - t0, bytes / (t1 - t0) * 1e-9);
+    printf("%-18s %10.4f %12.2f\n", "temporal blocking", t2 - t1, bytes / (t2 - t1) * 1e-9);
+    printf("max difference: %.3e\n", (a.get_values() - b.get_values()).norm());
+
+    if (snap > 0){
+      char name[FILENAME_LEN];
+      GFkt v(blocked);
+      t0 = omp_get_wtime();
+      myDomain.toFile("heat_grid.bin");
+      for (int s = snap; s <= steps; s += snap){
+        v = v.iterate(GFkt::LAPLACE, snap, dt);
+        snprintf(name, FILENAME_LEN, "heat_%04d.bin", s / snap);
+        v.toFile(name, "heat_grid.bin", (FieldFile::Codec)codec, tolerance);
+      }
+      t1 = omp_get_wtime();
+
+      // the next steps run while the previous snapshot is written
+      AsyncWriter writer(2);
+      v = blocked;
+      myDomain.toFile("heat_grid.bin", writer);
+      for (int s = snap; s <= steps; s += snap){
+        v = v.iterate(GFkt::LAPLACE, snap, dt);
+        snprintf(name, FILENAME_LEN, "heat_%04d.bin", s / snap);
+        v.toFile(name, "heat_grid.bin", writer, (FieldFile::Codec)codec, tolerance);
+      }
+      writer.flush();
+      t2 = omp_get_wtime();
+
+      printf("output every %-6d %10s\n", snap, "time [s]");
+      printf("%-18s %10.4f\n", "blocking", t1 - t0);
+      printf("%-18s %10.4f\n", "background writer", t2 - t1);
+    }
+  }
 
   // TODO: inline relevant member functions
 
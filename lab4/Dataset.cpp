@@ -0,0 +1,98 @@
+#include "Dataset.hpp"
+#include "FieldFile.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+static const char MAGIC[8] = "GFDATA1";
+
+DatasetWriter::DatasetWriter(const char* filename) : file(NULL), end(0) {
+  this->file = fopen(filename, "wb");
+  if (this->file == NULL)
+    throw std::invalid_argument("Could not open dataset file for writing");
+
+  // The header is written again by close, once the directory is known
+  const std::vector<char> head(ALIGN, '\0');
+  if (!this->put(head.data(), head.size())) {
+    fclose(this->file);
+    throw std::runtime_error("Could not write dataset file");
+  }
+}
+
+DatasetWriter::~DatasetWriter() {
+  try {
+    this->close();
+  } catch (...) {
+  }
+}
+
+bool DatasetWriter::put(const void* data, size_t size) {
+  this->end += size;
+  return fwrite(data, 1, size, this->file) == size;
+}
+
+void DatasetWriter::add(const Domain& grid) {
+  this->add("x", grid.x_data(), grid.ysize() + 1, grid.xsize() + 1);
+  this->add("y", grid.y_data(), grid.ysize() + 1, grid.xsize() + 1);
+}
+
+void DatasetWriter::add(const char* name, const Matrix& values) {
+  this->add(name, values.getArray(), values.getRows(), values.getCols());
+}
+
+void DatasetWriter::add(const char* name, const double* values, int rows, int cols) {
+  if (this->file == NULL) throw std::logic_error("Dataset is already closed");
+  if (rows < 0 || cols < 0) throw std::invalid_argument("Field size must be non-negative");
+  for (size_t e = 0; e < this->entries.size(); ++e)
+    if (this->entries[e].name == name)
+      throw std::invalid_argument("Dataset already has an entry of that name");
+
+  const size_t n = (size_t)rows * cols;
+  const size_t chunks = (n + FieldFile::CHUNK - 1) / FieldFile::CHUNK;
+  Entry entry = {name, rows, cols, std::vector<uint64_t>(chunks), std::vector<uint64_t>(chunks)};
+
+  const std::vector<char> pad(ALIGN, '\0');
+  bool ok = true;
+  for (size_t c = 0; ok && c < chunks; ++c) {
+    const size_t skip = (ALIGN - this->end % ALIGN) % ALIGN;
+    ok = this->put(pad.data(), skip);
+    entry.offsets[c] = this->end;
+    entry.sizes[c] = std::min((size_t)FieldFile::CHUNK, n - c*FieldFile::CHUNK) * sizeof(double);
+    ok = ok && this->put(values + c*FieldFile::CHUNK, entry.sizes[c]);
+  }
+  if (!ok)
+    throw std::runtime_error("Could not write dataset file");
+  this->entries.push_back(entry);
+}
+
+void DatasetWriter::close() {
+  if (this->file == NULL)
+    return;
+
+  const uint64_t dir_offset = this->end;
+  bool ok = true;
+  for (size_t e = 0; ok && e < this->entries.size(); ++e) {
+    const Entry& entry = this->entries[e];
+    const int32_t name_len = entry.name.size();
+    const std::string pad((8 - name_len % 8) % 8, '\0');
+    const int32_t head[6] = {entry.rows, entry.cols, (int32_t)sizeof(double), 0,
+      FieldFile::CHUNK, (int32_t)entry.offsets.size()};
+    ok = this->put(&name_len, sizeof(name_len))
+      && this->put(entry.name.data(), name_len)
+      && this->put(pad.data(), pad.size())
+      && this->put(head, sizeof(head))
+      && this->put(entry.offsets.data(), entry.offsets.size()*sizeof(uint64_t))
+      && this->put(entry.sizes.data(), entry.sizes.size()*sizeof(uint64_t));
+  }
+
+  const int32_t counts[2] = {(int32_t)this->entries.size(), ALIGN};
+  const uint64_t dir[2] = {dir_offset, this->end - dir_offset};
+  ok = ok && fseek(this->file, 0, SEEK_SET) == 0
+    && fwrite(MAGIC, 1, sizeof(MAGIC), this->file) == sizeof(MAGIC)
+    && fwrite(counts, sizeof(int32_t), 2, this->file) == 2
+    && fwrite(dir, sizeof(uint64_t), 2, this->file) == 2;
+
+  ok = fclose(this->file) == 0 && ok;
+  this->file = NULL;
+  if (!ok)
+    throw std::runtime_error("Could not write dataset file");
+}
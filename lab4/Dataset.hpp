@@ -0,0 +1,64 @@
+#ifndef DATASET_HPP
+#define DATASET_HPP
+
+#include "Matrix.hpp"
+#include "Domain.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One grid and any number of named fields on it in a single file, the
+// GFDATA1 format of lab4-linked, read by its gfield.read_dataset. Every
+// array is an entry of its own, split into chunks of FieldFile::CHUNK
+// values that each start on an ALIGN boundary, and a directory at the end
+// of the file tells where the chunks of each entry are. Native byte order:
+//
+//   char[8]  magic "GFDATA1"
+//   int32    number of entries, int32 alignment
+//   uint64   offset and size of the directory in bytes
+//   ...      zero padding up to ALIGN, then the chunks
+//   per entry in the directory:
+//     int32  length of the name, followed by the name zero padded to
+//            a multiple of 8 bytes
+//     int32  rows, cols, bytes per value, codec, values per chunk, chunks
+//     uint64 file offset of every chunk, then the stored size of every chunk
+//
+// The grid is stored as the entries "x" and "y", (ysize()+1) x (xsize()+1).
+// lab4 writes raw doubles only, codec 0.
+class DatasetWriter {
+
+public:
+  static const int ALIGN = 4096;
+
+  explicit DatasetWriter(const char* filename);
+  // Writes the directory if close was not called, errors are lost then
+  ~DatasetWriter();
+
+  // The grid, stored as the entries "x" and "y"
+  void add(const Domain& grid);
+  void add(const char* name, const double* values, int rows, int cols);
+  void add(const char* name, const Matrix& values);
+
+  // Writes the directory and closes the file
+  void close();
+
+private:
+  DatasetWriter(const DatasetWriter&);
+  DatasetWriter& operator=(const DatasetWriter&);
+
+  struct Entry {
+    std::string name;
+    int rows, cols;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> sizes;
+  };
+
+  FILE* file;
+  uint64_t end;
+  std::vector<Entry> entries;
+
+  bool put(const void* data, size_t size);
+};
+
+#endif //DATASET_HPP
@@ -195,6 +195,14 @@ std::vector<double> Domain::getY() const {
   return this->y_coor;
 }
 
+const double* Domain::x_data() const {
+	return this->x_coor.data();
+}
+
+const double* Domain::y_data() const {
+	return this->y_coor.data();
+}
+
 inline double Domain::phi1(const double s) {
   // from 1 to 0 when s goes from 0 to 1
 	return 1.0 - s;
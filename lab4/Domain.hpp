@@ -33,6 +33,9 @@ public:
 
 	std::vector<double> getX() const;
 	std::vector<double> getY() const;
+	// Coordinate arrays without copying, row-major (ysize()+1) x (xsize()+1)
+	const double* x_data() const;
+	const double* y_data() const;
 
 	int xsize() const;
 	int ysize() const;
@@ -0,0 +1,32 @@
+#include "FieldFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static const char MAGIC[8] = "GFIELD1";
+
+void FieldFile::write(const char* filename, const char* gridfile,
+                      const double* values, int rows, int cols) {
+  if (rows < 0 || cols < 0) throw std::invalid_argument("Field size must be non-negative");
+
+  FILE* file = fopen(filename, "wb");
+  if (file == NULL)
+    throw std::invalid_argument("Could not open field file for writing");
+
+  const int name_len = strlen(gridfile);
+  const int head[6] = {rows, cols, (int)sizeof(double), 0, CHUNK, name_len};
+  const size_t used = sizeof(MAGIC) + sizeof(head) + name_len;
+  const std::string pad((8 - used % 8) % 8, '\0');
+
+  const size_t n = (size_t)rows * cols;
+  bool ok = fwrite(MAGIC, 1, sizeof(MAGIC), file) == sizeof(MAGIC)
+    && fwrite(head, sizeof(int), 6, file) == 6
+    && fwrite(gridfile, 1, name_len, file) == (size_t)name_len
+    && fwrite(pad.data(), 1, pad.size(), file) == pad.size()
+    && fwrite(values, sizeof(double), n, file) == n;
+
+  ok = fclose(file) == 0 && ok;
+  if (!ok)
+    throw std::runtime_error("Could not write field file");
+}
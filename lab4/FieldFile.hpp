@@ -0,0 +1,26 @@
+#ifndef FIELDFILE_HPP
+#define FIELDFILE_HPP
+
+// Binary file with the values of one grid function, the same format as
+// the FieldFile of lab4-linked so its gfield.py reads both. The
+// coordinates are not repeated, the file names the grid file
+// (Domain::toFile format) the values belong to. Native byte order:
+//
+//   char[8]  magic "GFIELD1"
+//   int32    rows, cols
+//   int32    bytes per value, 8
+//   int32    codec, always 0 (raw) here
+//   int32    values per chunk, unused by raw files
+//   int32    length of the grid file name, followed by the name, zero
+//            padded so the data starts at a multiple of 8 bytes
+//   double   rows*cols values, row-major
+class FieldFile {
+
+public:
+  static const int CHUNK = 1 << 16;
+
+  static void write(const char* filename, const char* gridfile,
+                    const double* values, int rows, int cols);
+};
+
+#endif //FIELDFILE_HPP
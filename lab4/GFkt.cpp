@@ -1,5 +1,6 @@
 #include "GFkt.hpp"
 #include "Matrix.hpp"
+#include "FieldFile.hpp"
 
 #include <iostream>
 #include <memory>
@@ -8,6 +9,59 @@
 #include <iostream>
 #include <iomanip>
 
+// Derivative kernels on a row-major (rows x cols) array with unit grid
+// spacing h. Central differences inside, the second order one-sided
+// formula -(3f0 - 4f1 + f2)/(2h) towards the interior on the boundary.
+// Both directions walk the array row by row so the inner loop is
+// contiguous and vectorizable, the boundary rows/columns are peeled off
+// the inner loop. Same kernels as lab4-linked/src/GFkt.cpp, keep the two
+// in step.
+static void diff_xi(const double* in, double* out, const int rows, const int cols, const double h) {
+  const double c = 1/(2*h);
+
+  #pragma omp parallel for
+  for (int i = 0; i < rows; ++i) {
+    const double* r = in + i*cols;
+    double* o = out + i*cols;
+
+    o[0] = -c * (3*r[0] - 4*r[1] + r[2]);
+    #pragma omp simd
+    for (int j = 1; j < cols - 1; ++j) {
+      o[j] = c * (r[j+1] - r[j-1]);
+    }
+    o[cols-1] = c * (3*r[cols-1] - 4*r[cols-2] + r[cols-3]);
+  }
+}
+
+static void diff_eta(const double* in, double* out, const int rows, const int cols, const double h) {
+  const double c = 1/(2*h);
+
+  #pragma omp parallel for
+  for (int i = 0; i < rows; ++i) {
+    double* o = out + i*cols;
+
+    if (i == 0 || i == rows - 1) {
+      // one-sided, towards the interior
+      const int s = (i == 0) ? 1 : -1;
+      const double c1 = (i == 0) ? -c : c;
+      const double* r0 = in + i*cols;
+      const double* r1 = in + (i + s)*cols;
+      const double* r2 = in + (i + 2*s)*cols;
+      #pragma omp simd
+      for (int j = 0; j < cols; ++j) {
+        o[j] = c1 * (3*r0[j] - 4*r1[j] + r2[j]);
+      }
+    } else {
+      const double* up = in + (i+1)*cols;
+      const double* down = in + (i-1)*cols;
+      #pragma omp simd
+      for (int j = 0; j < cols; ++j) {
+        o[j] = c * (up[j] - down[j]);
+      }
+    }
+  }
+}
+
 GFkt::GFkt(std::shared_ptr<Domain> _grid) : u(_grid->ysize()+1, _grid->xsize()+1),
                                             grid(_grid) { } 
 GFkt::GFkt(const GFkt& gf) : u(gf.u), grid(gf.grid) { }
@@ -111,121 +165,42 @@ void GFkt::set_values(double (*f)(double x, double y)) {
 GFkt GFkt::dphix_dxi() const {
   // assume constant step size in xi
   GFkt tmp(grid);
-  double h = 1.0 / grid->xsize();
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
-    // j == 0
-    // tmp.u[i][0] = (1/h) * (grid->getPoint(i, 1).x - grid->getPoint(i, 0).x);
-    tmp.u[i][0] =  (3*grid->getPoint(i, 0).x - 4*grid->getPoint(i, 1).x + grid->getPoint(i, 2).x) / (3 * h);
-    for (int j = 1; j < grid->xsize(); ++j) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i, j+1).x - grid->getPoint(i, j-1).x);
-    }
-    // j == grid->xsize()
-    // tmp.u[i][grid->xsize()] = (1/h) * (grid->getPoint(i, grid->xsize()).x - grid->getPoint(i, grid->xsize() - 1).x);
-    tmp.u[i][grid->xsize()] = (3*grid->getPoint(i, grid->xsize()).x
-                              -4*grid->getPoint(i, grid->xsize() - 1).x
-                              +  grid->getPoint(i, grid->xsize() - 2).x) / (3 * h);
-  }
+  diff_xi(grid->x_data(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->xsize());
   return tmp;
 }
 
 GFkt GFkt::dphiy_dxi() const {
   // assume constant step size in xi
   GFkt tmp(grid);
-  double h = 1.0 / grid->xsize();
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
-    // j == 0
-    // tmp.u[i][0] = (1/h) * (grid->getPoint(i, 1).y - grid->getPoint(i, 0).y);
-    tmp.u[i][0] =  (3*grid->getPoint(i, 0).y - 4*grid->getPoint(i, 1).y + grid->getPoint(i, 2).y) / (3 * h);
-    for (int j = 1; j < grid->xsize(); ++j) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i, j+1).y - grid->getPoint(i, j-1).y);
-    }
-    // j == grid->xsize()
-    // tmp.u[i][grid->xsize()] = (1/h) * (grid->getPoint(i, grid->xsize()).y - grid->getPoint(i, grid->xsize() - 1).y);
-    tmp.u[i][grid->xsize()] = (3*grid->getPoint(i, grid->xsize()).y
-                              -4*grid->getPoint(i, grid->xsize() - 1).y
-                              +  grid->getPoint(i, grid->xsize() - 2).y) / (3 * h);
-  }
+  diff_xi(grid->y_data(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->xsize());
   return tmp;
 }
 
 GFkt GFkt::dphix_deta() const {
   // assume constant step size in eta
   GFkt tmp(grid);
-  double h = 1.0 / grid->ysize();
-  for (int j = 0; j < grid->xsize() + 1; ++j) {
-    // i == 0
-    // tmp.u[0][j] = (1/h) * (grid->getPoint(1, j).x - grid->getPoint(0, j).x);
-    tmp.u[0][j] =  (3*grid->getPoint(0, j).x - 4*grid->getPoint(1, j).x + grid->getPoint(2, j).x) / (3 * h);
-    for (int i = 1; i < grid->ysize(); ++i) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i+1, j).x - grid->getPoint(i-1, j).x);
-    }
-    // i == grid->ysize()
-    // tmp.u[grid->ysize()][j] = (1/h) * (grid->getPoint(grid->ysize(), j).x - grid->getPoint(grid->ysize() - 1, j).x);
-    tmp.u[grid->ysize()][j] = (3*grid->getPoint(grid->ysize(), j).x
-                              -4*grid->getPoint(grid->ysize() - 1, j).x
-                              +  grid->getPoint(grid->ysize() - 2, j).x) / (3 * h);
-  }
+  diff_eta(grid->x_data(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->ysize());
   return tmp;
 }
 
 GFkt GFkt::dphiy_deta() const {
   // assume constant step size in eta
   GFkt tmp(grid);
-  double h = 1.0 / grid->ysize();
-  for (int j = 0; j < grid->xsize() + 1; ++j) {
-    // i == 0
-    // tmp.u[0][j] = (1/h) * (grid->getPoint(1, j).y - grid->getPoint(0, j).y);
-    tmp.u[0][j] =  (3*grid->getPoint(0, j).y - 4*grid->getPoint(1, j).y + grid->getPoint(2, j).y) / (3 * h);
-    for (int i = 1; i < grid->ysize(); ++i) {
-      tmp.u[i][j] = (1/(2*h)) * (grid->getPoint(i+1, j).y - grid->getPoint(i-1, j).y);
-    }
-    // i == grid->ysize()
-    // tmp.u[grid->ysize()][j] = (1/h) * (grid->getPoint(grid->ysize(), j).y - grid->getPoint(grid->ysize() - 1, j).y);
-    tmp.u[grid->ysize()][j] = (3*grid->getPoint(grid->ysize(), j).y
-                          -4*grid->getPoint(grid->ysize() - 1, j).y
-                          +  grid->getPoint(grid->ysize() - 2, j).y) / (3 * h);
-  }
+  diff_eta(grid->y_data(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->ysize());
   return tmp;
 }
 
-
 GFkt GFkt::du_dxi() const {
   // assume constant step size in xi
   GFkt tmp(grid);
-  double h = 1.0 / grid->xsize();
-  for (int i = 0; i < grid->ysize() + 1; ++i) {
-    // j == 0
-    // tmp.u[i][0] = (1/h) * (u[i][1] - u[i][0]);
-    tmp.u[i][0] = (3*u[i][0] - 4*u[i][1] + u[i][2]) / (3 * h);
-    for (int j = 1; j < grid->xsize(); ++j) {
-      tmp.u[i][j] = (1/(2*h)) * (u[i][j+1] - u[i][j-1]);
-    }
-    //j == grid->xsize()
-    // tmp.u[i][grid->xsize()] = (1/h) * (u[i][grid->xsize()] - u[i][grid->xsize()-1]);
-    tmp.u[i][grid->xsize()] = (3*u[i][grid->xsize()]
-                              - 4*u[i][grid->xsize() - 1]
-                              + u[i][grid->xsize() - 2]) / (3 * h);
-  }
+  diff_xi(u.getArray(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->xsize());
   return tmp;
 }
 
 GFkt GFkt::du_deta() const {
   // assume constant step size in eta
   GFkt tmp(grid);
-  double h = 1.0 / grid->ysize();
-  for (int j = 0; j < grid->xsize() + 1; ++j) {
-    // i == 0
-    // tmp.u[0][j] = (1/h) * (u[1][j] - u[0][j]);
-    tmp.u[0][j] = (3*u[0][j] - 4*u[1][j] + u[2][j]) / (3 * h);
-    for (int i = 1; i < grid->ysize(); ++i) {
-      tmp.u[i][j] = (1/(2*h)) * (u[i+1][j] - u[i-1][j]);
-    }
-    //i == grid->ysize()
-    // tmp.u[grid->ysize()][j] = (1/h) * (u[grid->ysize()][j] - u[grid->ysize() - 1][j]);
-    tmp.u[grid->ysize()][j] = (3*u[grid->ysize()][j]
-                              - 4*u[grid->ysize() - 1][j]
-                              + u[grid->ysize() - 2][j]) / (3 * h);
-  }
+  diff_eta(u.getArray(), tmp.u.getArray(), grid->ysize() + 1, grid->xsize() + 1, 1.0 / grid->ysize());
   return tmp;
 }
 
@@ -247,3 +222,11 @@ void GFkt::toFile(const char* filename) const {
     ofile << zvals[i] << "\n";
   }
 }
+
+void GFkt::toFile(const char* filename, const char* gridfile) const {
+  FieldFile::write(filename, gridfile, u.getArray(), u.getRows(), u.getCols());
+}
+
+void GFkt::toFile(DatasetWriter& out, const char* name) const {
+  out.add(name, u);
+}
@@ -3,7 +3,9 @@
 
 #include "Matrix.hpp"
 #include "Domain.hpp"
+#include "Dataset.hpp"
 #include <memory>
+#include <cstdlib>
 
 class GFkt {
   private:
@@ -66,6 +68,10 @@ class GFkt {
     inline Matrix get_values() const { return this->u; }
 
     void toFile(const char* filename) const;
+    // Binary values only, FieldFile format, on the grid written to gridfile.
+    void toFile(const char* filename, const char* gridfile) const;
+    // Values as the entry name of a dataset, next to the grid and other fields
+    void toFile(DatasetWriter& out, const char* name) const;
 };
 
 #endif
\ No newline at end of file
@@ -74,10 +74,16 @@ int main(int argc, char const *argv[])
   GFkt Lapl = myGFkt_1.Laplace();
   // Lapl.get_values().print();
 
-  myGFkt_1.toFile("u.txt");
-  xder.toFile("xder.txt");
-  yder.toFile("yder.txt");
-  Lapl.toFile("Laplace.txt");
+  // The grid once and all fields in one file
+  {
+    DatasetWriter results("results.gfd");
+    results.add(myDomain);
+    myGFkt_1.toFile(results, "u");
+    xder.toFile(results, "xder");
+    yder.toFile(results, "yder");
+    Lapl.toFile(results, "Laplace");
+    results.close();
+  }
 
   return 0;
 } 
\ No newline at end of file
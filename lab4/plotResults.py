@@ -1,6 +1,12 @@
 import numpy as np
 from matplotlib import pyplot as plt
 from mpl_toolkits import mplot3d
+import os
+import sys
+
+# main writes the lab4-linked binary formats, read by its gfield module
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "lab4-linked"))
+import gfield
 
 def true_vals(x, y, mode):
     if mode == "xder":
@@ -15,14 +21,11 @@ def main():
     variants = ["u", "xder", "yder", "Laplace"]
     # variants = ["u", "xder"]
 
+    grid = gfield.read_dataset("results.gfd", ["x", "y"])
+    x, y = grid["x"].ravel(), grid["y"].ravel()
+
     for i, filename_base in enumerate(variants):
-        filename = filename_base + ".txt"
-        with open(filename, 'r') as f:
-            lines = list(f.readlines())
-            rows, cols = lines[0].split(", ")
-            lines = lines[1:]
-            lines = np.vstack(tuple(line.strip("\n").split(", ") for line in lines))
-            data = np.array(lines, dtype='float32')
+        z = gfield.read_dataset("results.gfd", [filename_base])[filename_base].ravel()
 
         fig = plt.figure()
         ax = plt.axes(projection='3d')
@@ -30,10 +33,6 @@ def main():
         err_fig = plt.figure()
         err_ax = plt.axes(projection='3d')
 
-        x = data[:,0]
-        y = data[:,1]
-        z = data[:,2]
-        
         ax.scatter(x, y, z, c=clrs[i])
         if i > 0:
             true_z = true_vals(x, y, mode=variants[i])